@@ -1,11 +1,823 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
 
-static void sht1x_data(const char* data) {
-	uint32_t inst = -1, cnt = -1, temp = -1, hum = -1;
-	if(4 != sscanf(data, "%x %x %x %x", &inst, &cnt, &temp, &hum)) {
+#include "lib/bmp180.h"
+#include "lib/cobs.h"
+#include "lib/trace_ids.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//memory
+//Buffers and per-series state are carved out of one arena at startup and
+//handed out by fixed pools, so the heap does not grow while running.
+
+struct ARENA {
+	uint8_t* base;
+	size_t size;
+	size_t used;
+	int frozen;
+	unsigned long failures;
+};
+
+struct POOL {
+	const char* name;
+	size_t obj_size;
+	size_t count;
+	void* free_list;
+	size_t used;
+	size_t max_used;
+	unsigned long failures;
+};
+
+static struct ARENA g_arena;
+
+static int arena_init(struct ARENA* ar, size_t size) {
+	//all pages are faulted in now, RSS stays flat afterwards
+	ar->base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(MAP_FAILED == ar->base) {
+		perror("arena");
+		return -1;
+	}
+	ar->size = size;
+	return 0;
+}
+
+//no allocations once frozen
+static void arena_freeze(struct ARENA* ar) {
+	ar->frozen = 1;
+}
+
+static void* arena_alloc(struct ARENA* ar, size_t size) {
+	size = (size + 15) & ~(size_t)15;
+	if(ar->frozen || size > ar->size - ar->used) {
+		ar->failures ++;
+		return 0;
+	}
+	void* res = ar->base + ar->used;
+	ar->used += size;
+	return res;
+}
+
+static int pool_init(struct POOL* pl, struct ARENA* ar, size_t obj_size, size_t count) {
+	pl->obj_size = (obj_size + 15) & ~(size_t)15;
+	pl->count = count;
+	uint8_t* pp = arena_alloc(ar, pl->obj_size * count);
+	if(!pp) {
+		return -1;
+	}
+	while(count --) {
+		*(void**)pp = pl->free_list;
+		pl->free_list = pp;
+		pp += pl->obj_size;
+	}
+	return 0;
+}
+
+static void* pool_get(struct POOL* pl) {
+	void* obj = pl->free_list;
+	if(!obj) {
+		pl->failures ++;
+		return 0;
+	}
+	pl->free_list = *(void**)obj;
+	memset(obj, 0, pl->obj_size);
+	if(++ pl->used > pl->max_used) {
+		pl->max_used = pl->used;
+	}
+	return obj;
+}
+
+static size_t pool_size(size_t obj_size, size_t count) {
+	return ((obj_size + 15) & ~(size_t)15) * count;
+}
+
+static long mem_rss_kb() {
+	long pages = 0;
+	FILE* pf = fopen("/proc/self/statm", "r");
+	if(pf) {
+		if(1 != fscanf(pf, "%*d %ld", &pages)) {
+			pages = 0;
+		}
+		fclose(pf);
+	}
+	return pages * (sysconf(_SC_PAGESIZE) >> 10);
+}
+
+static void pool_print_stats(const struct POOL* pl) {
+	fprintf(stderr, "\t%-14s = %zu/%zu used, max %zu, failures %lu\n",
+			pl->name, pl->used, pl->count, pl->max_used, pl->failures);
+}
+
+static void arena_print_stats(const struct ARENA* ar) {
+	fprintf(stderr, "memory: arena %zu/%zu bytes used, failures %lu, rss %ld kB\n",
+			ar->used, ar->size, ar->failures, mem_rss_kb());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//sinks
+//Decoders queue formatted records, a writer thread drains the queue to the
+//output fd. The reader never waits on output unless the policy is "block".
+
+#define SINK_REC_MAX	2048
+
+enum SINK_POLICY {
+	SP_BLOCK,
+	SP_DROP_NEWEST,
+	SP_DROP_OLDEST,
+	SP_SPILL
+};
+
+static const char* const sink_policy_names[] = {
+	"block", "drop-newest", "drop-oldest", "spill"
+};
+
+//The writer copies queued records into large buffers and hands them to the
+//backend: "write" writes them synchronously, "io_uring" submits registered
+//buffers and keeps filling the next one while the kernel writes.
+
+#define SIO_BUF_SIZE	(64 << 10)
+#define SIO_BUF_COUNT	8
+
+enum SIO_KIND {
+	SIO_WRITE,
+	SIO_URING
+};
+
+static const char* const sio_names[] = {
+	"write", "io_uring"
+};
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SIO_HAVE_URING
+#endif
+#endif
+
+#ifdef SIO_HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+//liburing is not required, the rings are mapped by hand
+struct URING {
+	int fd;
+	void* sq_ptr;
+	size_t sq_len;
+	void* cq_ptr;
+	size_t cq_len;
+	struct io_uring_sqe* sqes;
+	size_t sqes_len;
+	unsigned* sq_tail;
+	unsigned* sq_mask;
+	unsigned* sq_array;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned* cq_mask;
+	struct io_uring_cqe* cqes;
+};
+
+static void uring_close(struct URING* ur) {
+	if(ur->sqes) {
+		munmap(ur->sqes, ur->sqes_len);
+	}
+	if(ur->cq_ptr && ur->cq_ptr != ur->sq_ptr) {
+		munmap(ur->cq_ptr, ur->cq_len);
+	}
+	if(ur->sq_ptr) {
+		munmap(ur->sq_ptr, ur->sq_len);
+	}
+	if(ur->fd >= 0) {
+		close(ur->fd);
+	}
+	memset(ur, 0, sizeof(*ur));
+	ur->fd = -1;
+}
+
+static int uring_init(struct URING* ur, unsigned entries, const struct iovec* iov, unsigned count) {
+	struct io_uring_params prm;
+	memset(ur, 0, sizeof(*ur));
+	memset(&prm, 0, sizeof(prm));
+	ur->fd = syscall(__NR_io_uring_setup, entries, &prm);
+	if(ur->fd < 0) {
+		return -1;
+	}
+	ur->sq_len = prm.sq_off.array + prm.sq_entries * sizeof(unsigned);
+	ur->cq_len = prm.cq_off.cqes + prm.cq_entries * sizeof(struct io_uring_cqe);
+	if(prm.features & IORING_FEAT_SINGLE_MMAP && ur->sq_len < ur->cq_len) {
+		ur->sq_len = ur->cq_len;
+	}
+	ur->sq_ptr = mmap(0, ur->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ur->fd, IORING_OFF_SQ_RING);
+	if(ur->sq_ptr == MAP_FAILED) {
+		ur->sq_ptr = 0;
+		goto fail;
+	}
+	ur->cq_ptr = ur->sq_ptr;
+	if(!(prm.features & IORING_FEAT_SINGLE_MMAP)) {
+		ur->cq_ptr = mmap(0, ur->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				ur->fd, IORING_OFF_CQ_RING);
+		if(ur->cq_ptr == MAP_FAILED) {
+			ur->cq_ptr = 0;
+			goto fail;
+		}
+	}
+	ur->sqes_len = prm.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sqes = mmap(0, ur->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ur->fd, IORING_OFF_SQES);
+	if(ur->sqes == MAP_FAILED) {
+		ur->sqes = 0;
+		goto fail;
+	}
+	ur->sq_tail = (unsigned*)((uint8_t*)ur->sq_ptr + prm.sq_off.tail);
+	ur->sq_mask = (unsigned*)((uint8_t*)ur->sq_ptr + prm.sq_off.ring_mask);
+	ur->sq_array = (unsigned*)((uint8_t*)ur->sq_ptr + prm.sq_off.array);
+	ur->cq_head = (unsigned*)((uint8_t*)ur->cq_ptr + prm.cq_off.head);
+	ur->cq_tail = (unsigned*)((uint8_t*)ur->cq_ptr + prm.cq_off.tail);
+	ur->cq_mask = (unsigned*)((uint8_t*)ur->cq_ptr + prm.cq_off.ring_mask);
+	ur->cqes = (struct io_uring_cqe*)((uint8_t*)ur->cq_ptr + prm.cq_off.cqes);
+	//pinned once, so the kernel does not map the pages on every write
+	if(syscall(__NR_io_uring_register, ur->fd, IORING_REGISTER_BUFFERS, iov, count)) {
+		goto fail;
+	}
+	return 0;
+fail: {
+		int err = errno;
+		uring_close(ur);
+		errno = err;
+	}
+	return -1;
+}
+
+static void uring_prep_write(struct URING* ur, int fd, unsigned index, const uint8_t* data, size_t len,
+		off_t off) {
+	unsigned tail = *ur->sq_tail;
+	unsigned slot = tail & *ur->sq_mask;
+	struct io_uring_sqe* sqe = &ur->sqes[slot];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE_FIXED;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)data;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->buf_index = index;
+	sqe->user_data = index;
+	ur->sq_array[slot] = slot;
+	__atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_enter(struct URING* ur, unsigned submit, unsigned wait) {
+	return syscall(__NR_io_uring_enter, ur->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+}
+
+//returns 1 and the next completion, 0 if there is none
+static int uring_reap(struct URING* ur, unsigned* index, int* res) {
+	unsigned head = *ur->cq_head;
+	if(head == __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+	struct io_uring_cqe* cqe = &ur->cqes[head & *ur->cq_mask];
+	*index = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(ur->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+#else
+struct URING {
+	int fd;
+};
+
+static void uring_close(struct URING* ur) {
+	(void)ur;
+}
+
+static int uring_init(struct URING* ur, unsigned entries, const struct iovec* iov, unsigned count) {
+	(void)ur; (void)entries; (void)iov; (void)count;
+	errno = ENOSYS;
+	return -1;
+}
+
+static void uring_prep_write(struct URING* ur, int fd, unsigned index, const uint8_t* data, size_t len,
+		off_t off) {
+	(void)ur; (void)fd; (void)index; (void)data; (void)len; (void)off;
+}
+
+static int uring_enter(struct URING* ur, unsigned submit, unsigned wait) {
+	(void)ur; (void)submit; (void)wait;
+	errno = ENOSYS;
+	return -1;
+}
+
+static int uring_reap(struct URING* ur, unsigned* index, int* res) {
+	(void)ur; (void)index; (void)res;
+	return 0;
+}
+#endif
+
+struct SIO_BUF {
+	uint8_t* data;
+	size_t len;
+	size_t done;
+	off_t off;
+	int busy;
+};
+
+struct SINK_IO {
+	enum SIO_KIND kind;
+	struct SIO_BUF bufs[SIO_BUF_COUNT];
+	unsigned count;
+	unsigned next;
+	unsigned inflight;
+	unsigned queued;
+	//regular file: explicit offsets, several writes in flight,
+	//pipe, tty or O_APPEND: one write in flight at the current position
+	int ordered;
+	off_t off;
+	unsigned long writes;
+	unsigned long calls;
+	struct URING ur;
+};
+
+struct SINK_STATS {
+	unsigned long records;
+	unsigned long written;
+	unsigned long written_bytes;
+	unsigned long blocked;
+	double blocked_time;
+	unsigned long dropped_newest;
+	unsigned long dropped_oldest;
+	unsigned long spilled;
+	off_t spill_max;
+	unsigned long errors;
+};
+
+struct SINK {
+	const char* name;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	pthread_t writer;
+	int fd;
+	enum SINK_POLICY policy;
+	//records: uint16_t len, data[len]
+	uint8_t* ring;
+	size_t size;
+	size_t rd;
+	size_t wr;
+	size_t used;
+	int spill_fd;
+	off_t spill_rd;
+	off_t spill_wr;
+	int done;
+	struct SINK_STATS stats;
+	struct SINK_IO io;
+};
+
+#define SINK_INIT(sink_name, sink_fd) { \
+	.name = sink_name, \
+	.lock = PTHREAD_MUTEX_INITIALIZER, \
+	.not_empty = PTHREAD_COND_INITIALIZER, \
+	.not_full = PTHREAD_COND_INITIALIZER, \
+	.fd = sink_fd, \
+	.policy = SP_BLOCK, \
+	.size = 1 << 20, \
+	.spill_fd = -1, \
+	.io = {.ur = {.fd = -1}} \
+}
+
+static struct SINK g_sink = SINK_INIT("output", STDOUT_FILENO);
+static struct SINK g_capture = SINK_INIT("capture", -1);
+
+static double time_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int write_all(int fd, const uint8_t* data, size_t len) {
+	while(len) {
+		ssize_t res = write(fd, data, len);
+		if(res < 0 && errno == EINTR) {
+			continue;
+		}
+		if(res <= 0) {
+			return -1;
+		}
+		data += res;
+		len -= res;
+	}
+	return 0;
+}
+
+static void ring_put(struct SINK* sk, const void* data, size_t len) {
+	size_t part = sk->size - sk->wr;
+	if(part > len) {
+		part = len;
+	}
+	memcpy(sk->ring + sk->wr, data, part);
+	memcpy(sk->ring, (const uint8_t*)data + part, len - part);
+	sk->wr = (sk->wr + len) % sk->size;
+	sk->used += len;
+}
+
+static void ring_peek(const struct SINK* sk, void* data, size_t len) {
+	size_t part = sk->size - sk->rd;
+	if(part > len) {
+		part = len;
+	}
+	memcpy(data, sk->ring + sk->rd, part);
+	memcpy((uint8_t*)data + part, sk->ring, len - part);
+}
+
+static void ring_get(struct SINK* sk, void* data, size_t len) {
+	if(data) {
+		ring_peek(sk, data, len);
+	}
+	sk->rd = (sk->rd + len) % sk->size;
+	sk->used -= len;
+}
+
+static int sink_fits(const struct SINK* sk, size_t len) {
+	return sizeof(uint16_t) + len <= sk->size - sk->used;
+}
+
+static int sink_pending(const struct SINK* sk) {
+	return sk->used || sk->spill_rd != sk->spill_wr;
+}
+
+//Spill file I/O runs without the lock, so neither thread waits on the
+//other's disk access: under the lock the pushing thread (one per sink)
+//takes the end offset and publishes spill_wr after its write, the writer
+//thread takes spill_rd and moves it past the record after its read. Only
+//the pushing thread rewinds the file, when it is empty.
+
+//called with the lock held, returns with it held
+static int sink_spill(struct SINK* sk, const uint8_t* data, uint16_t len) {
+	int rewind = sk->spill_rd == sk->spill_wr && sk->spill_wr;
+	if(rewind) {
+		sk->spill_rd = sk->spill_wr = 0;
+	}
+	off_t off = sk->spill_wr;
+	pthread_mutex_unlock(&sk->lock);
+	struct iovec iov[2] = {
+		{.iov_base = &len, .iov_len = sizeof(len)},
+		{.iov_base = (void*)data, .iov_len = len}
+	};
+	int res = (rewind && ftruncate(sk->spill_fd, 0))
+			|| (ssize_t)(sizeof(len) + len) != pwritev(sk->spill_fd, iov, 2, off);
+	pthread_mutex_lock(&sk->lock);
+	if(res) {
+		return -1;
+	}
+	sk->spill_wr = off + sizeof(len) + len;
+	if(sk->stats.spill_max < sk->spill_wr - sk->spill_rd) {
+		sk->stats.spill_max = sk->spill_wr - sk->spill_rd;
+	}
+	return 0;
+}
+
+//called with the lock held, returns with it held;
+//returns 1 and leaves the record in place if it is longer than max
+static int sink_unspill(struct SINK* sk, uint8_t* data, size_t max, uint16_t* len) {
+	off_t off = sk->spill_rd;
+	int res = 0;
+	pthread_mutex_unlock(&sk->lock);
+	if(sizeof(*len) != pread(sk->spill_fd, len, sizeof(*len), off)
+			|| *len > SINK_REC_MAX) {
+		res = -1;
+	}
+	else if(*len > max) {
+		res = 1;
+	}
+	else if((ssize_t)*len != pread(sk->spill_fd, data, *len, off + sizeof(*len))) {
+		res = -1;
+	}
+	pthread_mutex_lock(&sk->lock);
+	if(res > 0) {
+		return res;
+	}
+	//a bad record: the rest of the file cannot be framed, drop it
+	sk->spill_rd = res ? sk->spill_wr : off + (off_t)(sizeof(*len) + *len);
+	return res;
+}
+
+//moves as many queued records as fit into buff, called with the lock held;
+//the lock is let go during spill file reads
+static size_t sink_take(struct SINK* sk, uint8_t* buff, size_t size) {
+	size_t len = 0;
+	while(1) {
+		uint16_t rec;
+		if(sk->used) {
+			ring_peek(sk, &rec, sizeof(rec));
+			if(len + rec > size) {
+				break;
+			}
+			ring_get(sk, 0, sizeof(rec));
+			ring_get(sk, buff + len, rec);
+			pthread_cond_signal(&sk->not_full);
+		}
+		else if(sk->spill_rd != sk->spill_wr) {
+			int res = sink_unspill(sk, buff + len, size - len, &rec);
+			if(res > 0) {
+				break;
+			}
+			if(res) {
+				sk->stats.errors ++;
+				continue;
+			}
+		}
+		else {
+			break;
+		}
+		len += rec;
+		sk->stats.written ++;
+	}
+	return len;
+}
+
+static void sink_io_done(struct SINK* sk, ssize_t res) {
+	pthread_mutex_lock(&sk->lock);
+	if(res < 0) {
+		sk->stats.errors ++;
+	}
+	else {
+		sk->stats.written_bytes += res;
+	}
+	pthread_mutex_unlock(&sk->lock);
+}
+
+static void sio_queue(struct SINK* sk, unsigned index) {
+	struct SIO_BUF* buf = &sk->io.bufs[index];
+	uring_prep_write(&sk->io.ur, sk->fd, index, buf->data + buf->done, buf->len - buf->done,
+			sk->io.ordered ? (off_t)(buf->off + buf->done) : -1);
+	sk->io.queued ++;
+}
+
+//submits queued writes and handles completions, waits for one if wait is set
+static void sio_poll(struct SINK* sk, int wait) {
+	struct SINK_IO* io = &sk->io;
+	if(io->queued || wait) {
+		int res = uring_enter(&io->ur, io->queued, wait);
+		io->calls ++;
+		if(res >= 0) {
+			io->queued -= res;
+		}
+		else if(errno != EINTR) {
+			//the ring is unusable, nothing queued will complete
+			for(unsigned i = 0; i < io->count; i ++) {
+				if(io->bufs[i].busy) {
+					io->bufs[i].busy = 0;
+					sink_io_done(sk, -1);
+				}
+			}
+			io->inflight = io->queued = 0;
+			return;
+		}
+	}
+	unsigned index;
+	int res;
+	while(uring_reap(&io->ur, &index, &res)) {
+		struct SIO_BUF* buf = &io->bufs[index];
+		if(res > 0 && buf->done + res < buf->len) {
+			//short write, the rest goes out from the same buffer
+			buf->done += res;
+			sio_queue(sk, index);
+			continue;
+		}
+		buf->busy = 0;
+		io->inflight --;
+		sink_io_done(sk, res > 0 ? (ssize_t)buf->len : -1);
+	}
+}
+
+static struct SIO_BUF* sio_get(struct SINK* sk) {
+	struct SINK_IO* io = &sk->io;
+	struct SIO_BUF* buf = &io->bufs[io->next];
+	while(buf->busy) {
+		sio_poll(sk, 1);
+	}
+	io->next = (io->next + 1) % io->count;
+	return buf;
+}
+
+//more - the writer has another buffer ready to go, so the submit can wait
+static void sio_submit(struct SINK* sk, struct SIO_BUF* buf, int more) {
+	struct SINK_IO* io = &sk->io;
+	io->writes ++;
+	if(io->kind == SIO_WRITE) {
+		io->calls ++;
+		sink_io_done(sk, write_all(sk->fd, buf->data, buf->len) ? -1 : (ssize_t)buf->len);
+		return;
+	}
+	while(!io->ordered && io->inflight) {
+		sio_poll(sk, 1);
+	}
+	buf->done = 0;
+	buf->off = io->off;
+	buf->busy = 1;
+	io->off += buf->len;
+	io->inflight ++;
+	sio_queue(sk, buf - io->bufs);
+	if(!more || !io->ordered) {
+		sio_poll(sk, 0);
+	}
+}
+
+static void sio_drain(struct SINK* sk) {
+	struct SINK_IO* io = &sk->io;
+	while(io->inflight) {
+		sio_poll(sk, 1);
+	}
+	if(io->ordered) {
+		//leave the file position where plain writes would have left it
+		lseek(sk->fd, io->off, SEEK_SET);
+	}
+	uring_close(&io->ur);
+}
+
+static int sio_open(struct SINK* sk) {
+	struct SINK_IO* io = &sk->io;
+	struct iovec iov[SIO_BUF_COUNT];
+	io->count = io->kind == SIO_URING ? SIO_BUF_COUNT : 1;
+	for(unsigned i = 0; i < io->count; i ++) {
+		io->bufs[i].data = arena_alloc(&g_arena, SIO_BUF_SIZE);
+		if(!io->bufs[i].data) {
+			fprintf(stderr, "sink %s: no memory for output buffers\n", sk->name);
+			return -1;
+		}
+		iov[i].iov_base = io->bufs[i].data;
+		iov[i].iov_len = SIO_BUF_SIZE;
+	}
+	if(io->kind == SIO_URING) {
+		int flags = fcntl(sk->fd, F_GETFL);
+		io->off = lseek(sk->fd, 0, SEEK_CUR);
+		io->ordered = io->off >= 0 && flags >= 0 && !(flags & O_APPEND);
+		if(uring_init(&io->ur, SIO_BUF_COUNT, iov, io->count)) {
+			fprintf(stderr, "sink %s: io_uring unavailable (%s), using write()\n",
+					sk->name, strerror(errno));
+			io->kind = SIO_WRITE;
+			io->count = 1;
+			io->ordered = 0;
+		}
+	}
+	return 0;
+}
+
+//arena bytes needed by sink_open(), with alignment slack
+static size_t sink_mem_size(const struct SINK* sk) {
+	unsigned count = sk->io.kind == SIO_URING ? SIO_BUF_COUNT : 1;
+	return sk->size + 16 + count * (SIO_BUF_SIZE + 16);
+}
+
+static void* sink_writer(void* arg) {
+	struct SINK* sk = arg;
+	pthread_mutex_lock(&sk->lock);
+	while(1) {
+		if(!sink_pending(sk)) {
+			if(sk->done) {
+				break;
+			}
+			pthread_cond_wait(&sk->not_empty, &sk->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&sk->lock);
+		struct SIO_BUF* buf = sio_get(sk);
+		pthread_mutex_lock(&sk->lock);
+		buf->len = sink_take(sk, buf->data, SIO_BUF_SIZE);
+		int more = sink_pending(sk);
+		pthread_mutex_unlock(&sk->lock);
+		if(buf->len) {
+			sio_submit(sk, buf, more);
+		}
+		pthread_mutex_lock(&sk->lock);
+	}
+	pthread_mutex_unlock(&sk->lock);
+	sio_drain(sk);
+	return 0;
+}
+
+static void sink_push(struct SINK* sk, const uint8_t* data, uint16_t len) {
+	pthread_mutex_lock(&sk->lock);
+	sk->stats.records ++;
+	if(sk->spill_rd != sk->spill_wr || !sink_fits(sk, len)) {
+		switch(sk->policy) {
+		case SP_BLOCK: {
+			double start = time_now();
+			sk->stats.blocked ++;
+			while(!sink_fits(sk, len)) {
+				pthread_cond_wait(&sk->not_full, &sk->lock);
+			}
+			sk->stats.blocked_time += time_now() - start;
+			break;
+		}
+		case SP_DROP_NEWEST:
+			sk->stats.dropped_newest ++;
+			goto unlock;
+		case SP_DROP_OLDEST:
+			while(!sink_fits(sk, len)) {
+				uint16_t old;
+				ring_get(sk, &old, sizeof(old));
+				ring_get(sk, 0, old);
+				sk->stats.dropped_oldest ++;
+			}
+			break;
+		case SP_SPILL:
+			if(sink_spill(sk, data, len)) {
+				sk->stats.errors ++;
+				goto unlock;
+			}
+			sk->stats.spilled ++;
+			goto signal;
+		}
+	}
+	ring_put(sk, &len, sizeof(len));
+	ring_put(sk, data, len);
+signal:
+	pthread_cond_signal(&sk->not_empty);
+unlock:
+	pthread_mutex_unlock(&sk->lock);
+}
+
+static int sink_open(struct SINK* sk, const char* spill_path) {
+	if(sk->policy == SP_SPILL) {
+		sk->spill_fd = open(spill_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if(sk->spill_fd < 0) {
+			perror(spill_path);
+			return -1;
+		}
+	}
+	sk->ring = arena_alloc(&g_arena, sk->size);
+	if(!sk->ring) {
+		fprintf(stderr, "sink %s: no memory for %zu bytes queue\n", sk->name, sk->size);
+		return -1;
+	}
+	if(sio_open(sk)) {
+		return -1;
+	}
+	return pthread_create(&sk->writer, 0, sink_writer, sk);
+}
+
+static void sink_print_stats(struct SINK* sk) {
+	pthread_mutex_lock(&sk->lock);
+	struct SINK_STATS st = sk->stats;
+	size_t used = sk->used;
+	off_t spill = sk->spill_wr - sk->spill_rd;
+	pthread_mutex_unlock(&sk->lock);
+	fprintf(stderr, "sink %s (%s): records %lu, written %lu (%lu bytes), queued %zu bytes\n"
+	"\tblocked        = %lu (%.3f s)\n"
+	"\tdropped newest = %lu\n"
+	"\tdropped oldest = %lu\n"
+	"\tspilled        = %lu (%lld bytes pending, max %lld)\n"
+	"\terrors         = %lu\n"
+	"\tio %-11s = %lu buffers, %lu syscalls\n",
+			sk->name, sink_policy_names[sk->policy], st.records, st.written, st.written_bytes, used,
+			st.blocked, st.blocked_time, st.dropped_newest, st.dropped_oldest,
+			st.spilled, (long long)spill, (long long)st.spill_max, st.errors,
+			sio_names[sk->io.kind], sk->io.writes, sk->io.calls);
+}
+
+static void sink_close(struct SINK* sk) {
+	pthread_mutex_lock(&sk->lock);
+	sk->done = 1;
+	pthread_cond_signal(&sk->not_empty);
+	pthread_mutex_unlock(&sk->lock);
+	pthread_join(sk->writer, 0);
+	if(sk->spill_fd >= 0) {
+		close(sk->spill_fd);
+	}
+}
+
+static void sink_printf(const char* fmt, ...) {
+	char buff[SINK_REC_MAX];
+	va_list ap;
+	va_start(ap, fmt);
+	int len = vsnprintf(buff, sizeof(buff), fmt, ap);
+	va_end(ap);
+	if(len < 0) {
 		return;
 	}
+	if((size_t)len >= sizeof(buff)) {
+		len = sizeof(buff) - 1;
+	}
+	sink_push(&g_sink, (const uint8_t*)buff, len);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//"$ func data" text lines
+
+static void sht1x_print(uint32_t inst, uint32_t cnt, uint32_t temp, uint32_t hum) {
 	float ftemp = temp;
 	float fhum = hum;
 	ftemp *= 0.01;
@@ -14,7 +826,7 @@ static void sht1x_data(const char* data) {
 		+ 0.0367 * fhum
 		- 1.5955e-6 * fhum * fhum
 		- 2.0468;
-	printf("SHT1X:\n"
+	sink_printf("SHT1X:\n"
 	"\tinstance = %d\n"
 	"\tcount    = %d\n"
 	"\ttemp     = %.1f\n"
@@ -22,25 +834,896 @@ static void sht1x_data(const char* data) {
 			inst, cnt, ftemp, fhum);
 }
 
+static void sht1x_data(const char* data) {
+	uint32_t inst = -1, cnt = -1, temp = -1, hum = -1;
+	if(4 != sscanf(data, "%x %x %x %x", &inst, &cnt, &temp, &hum)) {
+		return;
+	}
+	sht1x_print(inst, cnt, temp, hum);
+}
+
+//BMP180 samples from test14, compensated on the host:
+//"$ 01 inst cal[22]" - calibration block 0xAA..0xBF
+//"$ 02 inst cnt ut up" - raw temperature and pressure
+
+#define BMP180_INST_MAX		0x100
+#define BMP180_PENDING_MAX	64
+
+struct BMP180_RAW {
+	uint32_t cnt;
+	uint16_t ut;
+	int32_t up;
+};
+
+struct BMP180_STATE {
+	int valid;
+	struct BMP180_CAL cal;
+	size_t pending;
+	struct BMP180_RAW raw[BMP180_PENDING_MAX];
+};
+
+static struct POOL g_bmp180_pool = {.name = "bmp180 series", .count = 8};
+static struct BMP180_STATE* g_bmp180[BMP180_INST_MAX];
+
+static struct BMP180_STATE* bmp180_state(uint32_t inst) {
+	if(inst >= BMP180_INST_MAX) {
+		return 0;
+	}
+	if(!g_bmp180[inst]) {
+		g_bmp180[inst] = pool_get(&g_bmp180_pool);
+	}
+	return g_bmp180[inst];
+}
+
+//samples wait for the calibration block and are compensated in one batch
+static void bmp180_flush(uint32_t inst) {
+	struct BMP180_STATE* st = g_bmp180[inst];
+	struct BMP180_RESULT res[BMP180_PENDING_MAX];
+	for(size_t i = 0; i < st->pending; i ++) {
+		bmp180_compensate(&st->cal, st->raw[i].ut, st->raw[i].up, &res[i]);
+	}
+	for(size_t i = 0; i < st->pending; i ++) {
+		sink_printf("BMP180:\n"
+		"\tinstance = %u\n"
+		"\tcount    = %u\n"
+		"\ttemp     = %.1f\n"
+		"\tpressure = %d\n",
+				inst, st->raw[i].cnt, res[i].t / 10.0, res[i].p);
+	}
+	st->pending = 0;
+}
+
+static void bmp180_cal_data(const char* data) {
+	uint8_t buff[BMP180_CAL_LEN];
+	uint32_t inst = -1;
+	int pos = 0;
+	struct BMP180_STATE* st;
+	if(1 != sscanf(data, "%x%n", &inst, &pos) || !(st = bmp180_state(inst))) {
+		return;
+	}
+	for(size_t i = 0; i < sizeof(buff); i ++) {
+		uint32_t val;
+		int len = 0;
+		if(1 != sscanf(data + pos, "%x%n", &val, &len)) {
+			return;
+		}
+		buff[i] = val;
+		pos += len;
+	}
+	bmp180_parse_cal(&st->cal, buff);
+	st->valid = 1;
+	bmp180_flush(inst);
+}
+
+static void bmp180_raw_data(const char* data) {
+	uint32_t inst = -1, cnt = -1, ut = -1, up = -1;
+	struct BMP180_STATE* st;
+	if(4 != sscanf(data, "%x %x %x %x", &inst, &cnt, &ut, &up) || !(st = bmp180_state(inst))) {
+		return;
+	}
+	if(st->pending == BMP180_PENDING_MAX) {
+		memmove(st->raw, st->raw + 1, sizeof(st->raw) - sizeof(st->raw[0]));
+		st->pending --;
+	}
+	st->raw[st->pending ++] = (struct BMP180_RAW){cnt, ut, up};
+	if(st->valid) {
+		bmp180_flush(inst);
+	}
+}
+
 static void (*func_arr[])(const char* data) = {
-	sht1x_data
+	sht1x_data,
+	bmp180_cal_data,
+	bmp180_raw_data
+};
+
+static void line_data(const char* line) {
+	uint32_t func = -1;
+	const char* pp = line;
+	if(*pp ++ != '$' || *pp ++ != ' ') {
+		return;
+	}
+	sscanf(pp, "%02x", &func);
+	if(func >= sizeof(func_arr) / sizeof(func_arr[0])) {
+		return;
+	}
+	pp += 3;
+	func_arr[func](pp);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//COBS frames (lib/cobs.h): 00 COBS(func inst fields crc16) 00, fields LE
+
+#define FRAME_MAX_LEN	(COBS_FRAME_LEN(COBS_DATA_MAX) - 2)
+
+static struct {
+	unsigned long ok;
+	unsigned long bad;
+} g_frame_stats;
+
+//func 00: cnt temp hum, from test04 in binary mode
+static void sht1x_frame(const uint8_t* data, size_t len) {
+	if(len != 8) {
+		g_frame_stats.bad ++;
+		return;
+	}
+	sht1x_print(data[1], data[2] | data[3] << 8, data[4] | data[5] << 8, data[6] | data[7] << 8);
+}
+
+//func 03: event trace dump of lib/trace.h, one frame per part
+//part lost tick_us(2) {id arg ts(2)}...
+
+static const char* const trace_names[TRACE_ID_COUNT] = {
+	[TRACE_NONE] = "none",
+	[TRACE_WAKE] = "wake",
+	[TRACE_SLEEP] = "sleep",
+	[TRACE_RX_CHECK] = "rx_check",
+	[TRACE_RX_DONE] = "rx_done",
+	[TRACE_RX_READ] = "rx_read",
+	[TRACE_TX] = "tx",
+	[TRACE_TX_DONE] = "tx_done",
+	[TRACE_CMD] = "cmd"
+};
+
+//Timer1 wraps, the time base is kept across the parts of one dump
+static struct {
+	uint16_t ts;
+	uint64_t us;
+	unsigned events;
+} g_trace;
+
+static void trace_frame(const uint8_t* data, size_t len) {
+	if(len < 6 || (len - 6) % 4) {
+		g_frame_stats.bad ++;
+		return;
+	}
+	uint8_t part = data[2];
+	unsigned tick_us = data[4] | data[5] << 8;
+	if(!part) {
+		g_trace.events = 0;
+	}
+	sink_printf("TRACE: part %u, %zu events, %u us/tick, %u lost before\n",
+			part, (len - 6) / 4, tick_us, data[3]);
+	for(const uint8_t* pp = data + 6; pp < data + len; pp += 4) {
+		uint16_t ts = pp[2] | pp[3] << 8;
+		//less than one Timer1 wrap between two events is assumed
+		g_trace.us = g_trace.events ++ ? g_trace.us + (uint16_t)(ts - g_trace.ts) * tick_us : 0;
+		g_trace.ts = ts;
+		char name[16];
+		if(pp[0] < TRACE_ID_COUNT) {
+			snprintf(name, sizeof(name), "%s", trace_names[pp[0]]);
+		} else {
+			snprintf(name, sizeof(name), "user_%02x", pp[0]);
+		}
+		sink_printf("\t%10llu us  %-10s 0x%02x\n", (unsigned long long)g_trace.us, name, pp[1]);
+	}
+}
+
+//func 04: LoRa packet of the receivers (test07, test09)
+//payload[len] rssi snr ts(4)
+//rssi - RegPktRssiValue, snr - RegPktSnrValue (0.25 dB), ts - RTC ticks
+
+#define RADIO_HEAD_LEN	2
+#define RADIO_TAIL_LEN	6
+
+static void radio_frame(const uint8_t* data, size_t len) {
+	if(len < RADIO_HEAD_LEN + RADIO_TAIL_LEN) {
+		g_frame_stats.bad ++;
+		return;
+	}
+	size_t payload_len = len - RADIO_HEAD_LEN - RADIO_TAIL_LEN;
+	const uint8_t* tail = data + len - RADIO_TAIL_LEN;
+	int8_t snr = tail[1];
+	//SX1276 LF port, datasheet p. 87
+	int rssi = -164 + tail[0];
+	if(snr < 0) {
+		rssi += snr / 4;
+	}
+	uint32_t ts = tail[2] | tail[3] << 8 | tail[4] << 16 | (uint32_t)tail[5] << 24;
+	char payload[3 * COBS_DATA_MAX + 1] = "";
+	for(size_t i = 0; i < payload_len; i ++) {
+		sprintf(payload + 3 * i, " %02x", data[RADIO_HEAD_LEN + i]);
+	}
+	sink_printf("RADIO:\n"
+	"\tlength    = %zu\n"
+	"\tpayload   =%s\n"
+	"\trssi      = %d\n"
+	"\tsnr       = %.2f\n"
+	"\ttimestamp = %u\n",
+			payload_len, payload, rssi, snr * 0.25, ts);
+}
+
+//rec - COBS_FRAME_LEN(RADIO_HEAD_LEN + len + RADIO_TAIL_LEN) bytes
+static size_t radio_encode(uint8_t* rec, const uint8_t* payload, uint8_t len,
+		uint8_t rssi, int8_t snr, uint32_t ts) {
+	uint8_t data[COBS_DATA_MAX];
+	uint8_t* pp = data;
+	*pp ++ = RADIO_FUNC;
+	*pp ++ = 0;
+	memcpy(pp, payload, len);
+	pp += len;
+	*pp ++ = rssi;
+	*pp ++ = snr;
+	*pp ++ = ts;
+	*pp ++ = ts >> 8;
+	*pp ++ = ts >> 16;
+	*pp ++ = ts >> 24;
+	return cobs_frame(rec, data, pp - data);
+}
+
+static void (*frame_func_arr[])(const uint8_t* data, size_t len) = {
+	[0] = sht1x_frame,
+	[TRACE_FUNC] = trace_frame,
+	[RADIO_FUNC] = radio_frame
 };
 
-int main() {
-	char  buff[256];
-	while(fgets(buff, sizeof(buff), stdin)) {
-		uint32_t func = -1;
-		char* pp = buff;
-		if(*pp ++ != '$' || *pp ++ != ' ') {
+static void frame_data(const uint8_t* frame, size_t len) {
+	uint8_t data[FRAME_MAX_LEN];
+	int16_t data_len = cobs_unframe(data, frame, len);
+	if(data_len < 2 || data[0] >= sizeof(frame_func_arr) / sizeof(frame_func_arr[0]) || !frame_func_arr[data[0]]) {
+		g_frame_stats.bad ++;
+		return;
+	}
+	g_frame_stats.ok ++;
+	frame_func_arr[data[0]](data, data_len);
+}
+
+static void frame_print_stats() {
+	fprintf(stderr, "frames: %lu ok, %lu bad\n", g_frame_stats.ok, g_frame_stats.bad);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//input stream: text lines and COBS frames
+
+#define LINE_MAX_LEN	256
+
+struct PARSER {
+	enum {
+		PS_IDLE,
+		PS_LINE,
+		PS_FRAME
+	} state;
+	size_t len;
+	uint8_t buff[FRAME_MAX_LEN > LINE_MAX_LEN ? FRAME_MAX_LEN : LINE_MAX_LEN];
+};
+
+static void parser_feed(struct PARSER* ps, const uint8_t* data, size_t len) {
+	while(len --) {
+		uint8_t ch = *data ++;
+		switch(ps->state) {
+		case PS_IDLE:
+			ps->len = 0;
+			if(!ch) {
+				ps->state = PS_FRAME;
+				break;
+			}
+			ps->state = PS_LINE;
+			//fall through
+		case PS_LINE:
+			//text has no 0x00: a frame that lost its leading 0x00, the CRC tells;
+			//a line longer than a frame is noise
+			if(!ch) {
+				if(ps->len > FRAME_MAX_LEN) {
+					g_frame_stats.bad ++;
+				} else {
+					frame_data(ps->buff, ps->len);
+				}
+				ps->state = PS_IDLE;
+				break;
+			}
+			if(ps->len < LINE_MAX_LEN - 1) {
+				ps->buff[ps->len ++] = ch;
+			}
+			if(ch == '\n') {
+				ps->buff[ps->len] = 0;
+				line_data((const char*)ps->buff);
+				ps->state = PS_IDLE;
+			}
+			break;
+		case PS_FRAME:
+			//back to back 0x00 edges, or the closing 0x00 of a lost frame
+			if(!ch && !ps->len) {
+				break;
+			}
+			if(ch) {
+				if(ps->len < FRAME_MAX_LEN) {
+					ps->buff[ps->len] = ch;
+				}
+				ps->len ++;
+				break;
+			}
+			if(ps->len > FRAME_MAX_LEN) {
+				g_frame_stats.bad ++;
+			} else {
+				frame_data(ps->buff, ps->len);
+			}
+			ps->state = PS_IDLE;
+			break;
+		}
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//record and replay of raw input
+//capture file: chunks of uint64_t ns since start, uint32_t len, data[len]
+
+struct CAPTURE_HDR {
+	uint64_t ns;
+	uint32_t len;
+} __attribute__((packed));
+
+//each chunk goes to the capture sink as one record, header and data, so the
+//writer thread stores it without the reader waiting on the disk and a drop
+//policy loses whole chunks only; chunks larger than a record are split into
+//chunks of the same timestamp
+static void capture_write(struct SINK* sk, double start, const uint8_t* data, uint32_t len) {
+	uint8_t rec[SINK_REC_MAX];
+	struct CAPTURE_HDR hdr = {
+		.ns = (time_now() - start) * 1e9
+	};
+	while(len) {
+		hdr.len = len < sizeof(rec) - sizeof(hdr) ? len : sizeof(rec) - sizeof(hdr);
+		memcpy(rec, &hdr, sizeof(hdr));
+		memcpy(rec + sizeof(hdr), data, hdr.len);
+		sink_push(sk, rec, sizeof(hdr) + hdr.len);
+		data += hdr.len;
+		len -= hdr.len;
+	}
+}
+
+static void sleep_until(double when) {
+	struct timespec ts = {
+		.tv_sec = when,
+		.tv_nsec = (when - (time_t)when) * 1e9
+	};
+	while(EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0));
+}
+
+static int pty_open() {
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0 || grantpt(fd) || unlockpt(fd)) {
+		perror("pty");
+		return -1;
+	}
+	//keep the slave open and raw, so data written before a reader attaches is kept as is
+	int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+	struct termios tio;
+	if(slave < 0 || tcgetattr(slave, &tio)) {
+		perror(ptsname(fd));
+		return -1;
+	}
+	cfmakeraw(&tio);
+	tcsetattr(slave, TCSANOW, &tio);
+	fprintf(stderr, "replay: %s, press <ENTER> to start\n", ptsname(fd));
+	getchar();
+	return fd;
+}
+
+//speed: 1 - original timing, N - N times faster, 0 - as fast as possible
+static int replay(struct PARSER* ps, const char* path, double speed, int to_pty) {
+	FILE* pf = fopen(path, "rb");
+	if(!pf) {
+		perror(path);
+		return -1;
+	}
+	int fd = to_pty ? pty_open() : -1;
+	if(to_pty && fd < 0) {
+		fclose(pf);
+		return -1;
+	}
+	static uint8_t buff[1 << 16];
+	struct CAPTURE_HDR hdr;
+	unsigned long chunks = 0, bytes = 0;
+	uint64_t last_ns = 0;
+	int res = 0;
+	double start = time_now();
+	while(1 == fread(&hdr, sizeof(hdr), 1, pf)) {
+		if(hdr.len > sizeof(buff) || 1 != fread(buff, hdr.len, 1, pf)) {
+			fprintf(stderr, "%s: truncated capture\n", path);
+			res = -1;
+			break;
+		}
+		if(speed > 0) {
+			sleep_until(start + hdr.ns * 1e-9 / speed);
+		}
+		if(to_pty) {
+			if(write_all(fd, buff, hdr.len)) {
+				perror("pty");
+				res = -1;
+				break;
+			}
+		}
+		else {
+			parser_feed(ps, buff, hdr.len);
+		}
+		chunks ++;
+		bytes += hdr.len;
+		last_ns = hdr.ns;
+	}
+	double secs = time_now() - start;
+	fprintf(stderr, "replay: %lu chunks, %lu bytes, %.3f s (captured %.3f s), %.0f bytes/s\n",
+			chunks, bytes, secs, last_ns * 1e-9, bytes / secs);
+	if(to_pty) {
+		close(fd);
+	}
+	fclose(pf);
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//serial port and the baud rate switch of lib/baud_switch.h (test07)
+
+//the firmware goes back to the old rate after this much without "baud"
+#define BAUD_SWITCH_TIMEOUT_MS	1000
+
+//fastest first
+static const struct {
+	unsigned rate;
+	speed_t speed;
+} tty_speeds[] = {
+	{1000000, B1000000},
+	{500000, B500000},
+	{230400, B230400},
+	{115200, B115200},
+	{57600, B57600},
+	{38400, B38400},
+	{19200, B19200},
+	{9600, B9600}
+};
+
+static int tty_set_rate(int fd, unsigned rate) {
+	struct termios tio;
+	size_t i = 0;
+	while(i < sizeof(tty_speeds) / sizeof(tty_speeds[0]) && tty_speeds[i].rate != rate) {
+		i ++;
+	}
+	if(i == sizeof(tty_speeds) / sizeof(tty_speeds[0]) || tcgetattr(fd, &tio)) {
+		return -1;
+	}
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, tty_speeds[i].speed);
+	cfsetospeed(&tio, tty_speeds[i].speed);
+	return tcsetattr(fd, TCSANOW, &tio);
+}
+
+static int tty_open(const char* path, unsigned rate) {
+	int fd = open(path, O_RDWR | O_NOCTTY);
+	if(fd < 0 || tty_set_rate(fd, rate)) {
+		fprintf(stderr, "%s: %s\n", path, fd < 0 ? strerror(errno) : "can not set the baud rate");
+		return -1;
+	}
+	return fd;
+}
+
+//next line without CR and LF; 0 - timeout
+static int tty_read_line(int fd, char* line, size_t size, int timeout_ms) {
+	double end = time_now() + timeout_ms * 1e-3;
+	size_t len = 0;
+	while(1) {
+		double left = end - time_now();
+		struct pollfd pfd = {.fd = fd, .events = POLLIN};
+		char ch;
+		if(left <= 0) {
+			return 0;
+		}
+		if(1 != poll(&pfd, 1, left * 1e3 + 1) || 1 != read(fd, &ch, 1)) {
 			continue;
 		}
-		sscanf(pp, "%02x", &func);
-		if(func > 0) {
+		if(ch == '\n') {
+			line[len] = 0;
+			return 1;
+		}
+		if(ch != '\r' && len < size - 1) {
+			line[len ++] = ch;
+		}
+	}
+}
+
+//waits for one of the replies, other lines (telemetry) are dropped
+static int tty_wait_reply(int fd, const char* ok, const char* err) {
+	char line[128];
+	while(tty_read_line(fd, line, sizeof(line), BAUD_SWITCH_TIMEOUT_MS)) {
+		if(!strcmp(line, ok)) {
+			return 0;
+		}
+		if(err && !strcmp(line, err)) {
+			return -1;
+		}
+	}
+	return -1;
+}
+
+//tries the rates above the current one, fastest first; returns the rate in use
+static unsigned tty_step_up(int fd, unsigned rate) {
+	for(size_t i = 0; i < sizeof(tty_speeds) / sizeof(tty_speeds[0]) && tty_speeds[i].rate > rate; i ++) {
+		unsigned next = tty_speeds[i].rate;
+		dprintf(fd, "baud %u\r", next / 100);
+		if(tty_wait_reply(fd, "baud ok", "baud err")) {
+			fprintf(stderr, "baud %u: not offered\n", next);
 			continue;
 		}
-		pp += 3;
-		func_arr[func](pp);
+		tcdrain(fd);
+		tty_set_rate(fd, next);
+		dprintf(fd, "baud\r");
+		if(!tty_wait_reply(fd, "baud ok", 0)) {
+			fprintf(stderr, "baud %u\n", next);
+			return next;
+		}
+		fprintf(stderr, "baud %u: no confirmation\n", next);
+		tty_set_rate(fd, rate);
+		//by now the firmware is back at the old rate, drop what came at the wrong one
+		usleep(100000);
+		tcflush(fd, TCIOFLUSH);
 	}
+	return rate;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void mem_print_stats() {
+	arena_print_stats(&g_arena);
+	pool_print_stats(&g_bmp180_pool);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//replay benchmark: synthetic records pushed through the parser and sinks
+
+static double cpu_time() {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+//test04 link: UBRR 0 at 8 MHz, 8N1 - 10 bits per byte
+#define BENCH_BAUD		500000
+
+enum BENCH_KIND {
+	BENCH_RADIO,
+	BENCH_TEXT,
+	BENCH_FRAME
+};
+
+static const char* const bench_names[] = {
+	"radio",
+	"text",
+	"frame"
+};
+
+//n-th synthetic record: 32 bytes radio payload, or an SHT1x reading as text or COBS frame
+static size_t bench_encode(enum BENCH_KIND kind, uint8_t* rec, unsigned long n) {
+	uint8_t payload[32];
+	switch(kind) {
+	case BENCH_RADIO:
+		for(size_t i = 0; i < sizeof(payload); i ++) {
+			payload[i] = 'L' + i;
+		}
+		return radio_encode(rec, payload, sizeof(payload), 0x40, -6, n);
+	case BENCH_TEXT:
+		return sprintf((char*)rec, "$ 00 00 %04x %04x %04x\r\n", (unsigned)(n & 0xFFFF), 0x1a2b, 0x0c3d);
+	case BENCH_FRAME:
+		payload[0] = 0;
+		payload[1] = 0;
+		payload[2] = n;
+		payload[3] = n >> 8;
+		payload[4] = 0x2b;
+		payload[5] = 0x1a;
+		payload[6] = 0x3d;
+		payload[7] = 0x0c;
+		return cobs_frame(rec, payload, 8);
+	}
+	return 0;
+}
+
+static int bench_run(struct PARSER* ps, unsigned long count, enum BENCH_KIND kind) {
+	uint8_t chunk[4096];
+	size_t rec_len = 0, chunk_len = 0;
+	unsigned long recs = 0;
+	while(chunk_len + COBS_FRAME_LEN(COBS_DATA_MAX) <= sizeof(chunk)) {
+		rec_len = bench_encode(kind, chunk + chunk_len, recs ++);
+		chunk_len += rec_len;
+	}
+	//warm up stacks and the writer thread before taking the RSS baseline
+	parser_feed(ps, chunk, chunk_len);
+	recs = chunk_len / rec_len;
+	long rss = mem_rss_kb();
+	double start = time_now();
+	double cpu = cpu_time();
+	while(recs < count) {
+		parser_feed(ps, chunk, chunk_len);
+		recs += chunk_len / rec_len;
+	}
+	sink_close(&g_sink);
+	double secs = time_now() - start;
+	cpu = cpu_time() - cpu;
+	fprintf(stderr, "%s: %lu records, %.3f s, cpu %.3f s, %.0f records/s, %.2f MB/s, rss %ld -> %ld kB\n",
+			bench_names[kind], recs, secs, cpu, recs / secs, recs * rec_len / secs / 1e6, rss, mem_rss_kb());
+	fprintf(stderr, "%s: %zu bytes/record, %.0f records/s at %u baud\n",
+			bench_names[kind], rec_len, BENCH_BAUD / 10.0 / rec_len, BENCH_BAUD);
+	sink_print_stats(&g_sink);
+	if(kind == BENCH_FRAME) {
+		frame_print_stats();
+	}
+	mem_print_stats();
 	return 0;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//EEPROM image of isr_stat_save() (lib/isr_stat.h), "make isr_read"
+
+#define ISR_STAT_HDR	7
+#define ISR_STAT_LEN	10
+
+static void isr_stat_line(const char* name, const uint8_t* pp, unsigned div, unsigned khz) {
+	unsigned count = pp[0] | pp[1] << 8;
+	unsigned min = pp[2] | pp[3] << 8;
+	unsigned max = pp[4] | pp[5] << 8;
+	uint32_t sum = pp[6] | pp[7] << 8 | pp[8] << 16 | (uint32_t)pp[9] << 24;
+	if(!count) {
+		printf("\t%s: no samples\n", name);
+		return;
+	}
+	double avg = (double)sum / count;
+	printf("\t%s: %u x, cycles min %u avg %.1f max %u, us min %.1f avg %.1f max %.1f\n",
+			name, count, min * div, avg * div, max * div,
+			1e3 * min * div / khz, 1e3 * avg * div / khz, 1e3 * max * div / khz);
+}
+
+static int isr_stat_file(const char* path) {
+	uint8_t buff[ISR_STAT_HDR + 255 * 2 * ISR_STAT_LEN];
+	FILE* ff = fopen(path, "rb");
+	if(!ff) {
+		perror(path);
+		return 1;
+	}
+	size_t len = fread(buff, 1, sizeof(buff), ff);
+	fclose(ff);
+	if(len < ISR_STAT_HDR || buff[0] != 'I' || buff[1] != 'S'
+			|| len < (size_t)(ISR_STAT_HDR + buff[2] * 2 * ISR_STAT_LEN)) {
+		fprintf(stderr, "%s: no isr_stat_save() image\n", path);
+		return 1;
+	}
+	unsigned div = buff[3] | buff[4] << 8;
+	unsigned khz = buff[5] | buff[6] << 8;
+	if(!div || !khz) {
+		fprintf(stderr, "%s: Timer1 stopped or F_CPU 0\n", path);
+		return 1;
+	}
+	printf("%u slots, F_CPU %u kHz, Timer1 / %u\n", buff[2], khz, div);
+	for(unsigned i = 0; i < buff[2]; i ++) {
+		const uint8_t* pp = buff + ISR_STAT_HDR + i * 2 * ISR_STAT_LEN;
+		printf("slot %u\n", i);
+		isr_stat_line("exec", pp, div, khz);
+		isr_stat_line("wake", pp + ISR_STAT_LEN, div, khz);
+	}
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static volatile sig_atomic_t g_print_stats = 0;
+
+static void on_sigusr1(int sig) {
+	(void)sig;
+	g_print_stats = 1;
+}
+
+static void show_usage(const char* name) {
+	fprintf(stderr, "Usage: %s [-p policy] [-q size] [-f spill_file] [-o backend] [-n series]\n"
+	"\t\t[-d tty [-s rate] [-u]] [-w capture] [-r capture [-x speed] [-t]] [-b count [-k kind]]\n"
+	"\t\t[-e isr_stat.bin]\n"
+	"\t-p policy     - slow output and capture handling: block, drop-newest, drop-oldest, spill\n"
+	"\t-q size       - output queue size in KiB, default 1024\n"
+	"\t-f spill_file - spill file for \"-p spill\", default client.spill; capture: spill_file.capture\n"
+	"\t-o backend    - output and capture writes: write (default), io_uring\n"
+	"\t-n series     - max. number of BMP180 instances, default 8\n"
+	"\t-d tty        - read a serial port instead of stdin\n"
+	"\t-s rate       - serial port baud rate, default 38400\n"
+	"\t-u            - switch to the fastest rate the firmware confirms (\"baud\" command)\n"
+	"\t-w capture    - record raw input chunks with timestamps\n"
+	"\t-r capture    - replay recorded input instead of reading stdin\n"
+	"\t-x speed      - replay speed: 1 - original timing (default), N - N times faster, 0 - max\n"
+	"\t-t            - replay into a new pty instead of the decoder\n"
+	"\t-b count      - benchmark decoding of count records\n"
+	"\t-k kind       - benchmark records: radio (default), text or frame (SHT1x)\n"
+	"\t-e file       - print the ISR statistics of an EEPROM image (make isr_read)\n"
+	"SIGUSR1 prints output queue and memory counters to stderr.\n", name);
+}
+
+static int parse_name(const char* name, const char* const* names, int count) {
+	for(int i = 0; i < count; i ++) {
+		if(!strcmp(name, names[i])) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+int main(int argc, char* argv[]) {
+	const char* spill_path = "client.spill";
+	const char* capture_path = 0;
+	const char* replay_path = 0;
+	double speed = 1;
+	int to_pty = 0;
+	unsigned long bench = 0;
+	enum BENCH_KIND bench_kind = BENCH_RADIO;
+	const char* tty_path = 0;
+	unsigned tty_rate = 38400;
+	int step_up = 0;
+	int in_fd = STDIN_FILENO;
+	int opt;
+	while(-1 != (opt = getopt(argc, argv, "p:q:f:o:n:d:s:uw:r:x:tb:k:e:"))) {
+		switch(opt) {
+		case 'p':
+			if(0 > (opt = parse_name(optarg, sink_policy_names,
+					sizeof(sink_policy_names) / sizeof(sink_policy_names[0])))) {
+				show_usage(argv[0]);
+				return 1;
+			}
+			g_sink.policy = g_capture.policy = opt;
+			break;
+		case 'o':
+			if(0 > (opt = parse_name(optarg, sio_names, sizeof(sio_names) / sizeof(sio_names[0])))) {
+				show_usage(argv[0]);
+				return 1;
+			}
+			g_sink.io.kind = g_capture.io.kind = opt;
+			break;
+		case 'q':
+			g_sink.size = strtoul(optarg, 0, 0) << 10;
+			if(g_sink.size < 2 * SINK_REC_MAX) {
+				g_sink.size = 2 * SINK_REC_MAX;
+			}
+			break;
+		case 'f':
+			spill_path = optarg;
+			break;
+		case 'n':
+			g_bmp180_pool.count = strtoul(optarg, 0, 0);
+			break;
+		case 'd':
+			tty_path = optarg;
+			break;
+		case 's':
+			tty_rate = strtoul(optarg, 0, 0);
+			break;
+		case 'u':
+			step_up = 1;
+			break;
+		case 'w':
+			capture_path = optarg;
+			break;
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 'x':
+			speed = strtod(optarg, 0);
+			break;
+		case 't':
+			to_pty = 1;
+			break;
+		case 'b':
+			bench = strtoul(optarg, 0, 0);
+			break;
+		case 'k':
+			if(0 > (opt = parse_name(optarg, bench_names, sizeof(bench_names) / sizeof(bench_names[0])))) {
+				show_usage(argv[0]);
+				return 1;
+			}
+			bench_kind = opt;
+			break;
+		case 'e':
+			return isr_stat_file(optarg);
+		default:
+			show_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(replay_path && to_pty) {
+		return !!replay(0, replay_path, speed, to_pty);
+	}
+
+	char capture_spill[4096];
+	snprintf(capture_spill, sizeof(capture_spill), "%s.capture", spill_path);
+	if(capture_path && !bench
+			&& 0 > (g_capture.fd = open(capture_path, O_WRONLY | O_CREAT | O_TRUNC, 0644))) {
+		perror(capture_path);
+		return 1;
+	}
+	//16 bytes alignment slack per allocation
+	if(arena_init(&g_arena, sizeof(struct PARSER) + 16
+			+ pool_size(sizeof(struct BMP180_STATE), g_bmp180_pool.count) + 16
+			+ sink_mem_size(&g_sink) + (g_capture.fd >= 0 ? sink_mem_size(&g_capture) : 0))) {
+		return 1;
+	}
+	struct PARSER* ps = arena_alloc(&g_arena, sizeof(*ps));
+	if(!ps || pool_init(&g_bmp180_pool, &g_arena, sizeof(struct BMP180_STATE), g_bmp180_pool.count)
+			|| sink_open(&g_sink, spill_path)
+			|| (g_capture.fd >= 0 && sink_open(&g_capture, capture_spill))) {
+		return 1;
+	}
+	arena_freeze(&g_arena);
+	if(bench) {
+		return bench_run(ps, bench, bench_kind);
+	}
+
+	if(tty_path && !replay_path) {
+		if(0 > (in_fd = tty_open(tty_path, tty_rate))) {
+			return 1;
+		}
+		if(step_up) {
+			tty_step_up(in_fd, tty_rate);
+		}
+	}
+
+	struct sigaction sa = {.sa_handler = on_sigusr1};
+	sigaction(SIGUSR1, &sa, 0);
+
+	double start = time_now();
+	uint8_t buff[4096];
+	while(!replay_path) {
+		ssize_t len = read(in_fd, buff, sizeof(buff));
+		if(g_print_stats) {
+			g_print_stats = 0;
+			sink_print_stats(&g_sink);
+			if(g_capture.fd >= 0) {
+				sink_print_stats(&g_capture);
+			}
+			frame_print_stats();
+			mem_print_stats();
+		}
+		if(len < 0 && errno == EINTR) {
+			continue;
+		}
+		if(len <= 0) {
+			break;
+		}
+		if(g_capture.fd >= 0) {
+			capture_write(&g_capture, start, buff, len);
+		}
+		parser_feed(ps, buff, len);
+	}
+	if(in_fd != STDIN_FILENO) {
+		close(in_fd);
+	}
+	if(replay_path) {
+		replay(ps, replay_path, speed, 0);
+	}
+	sink_close(&g_sink);
+	if(g_sink.stats.blocked || g_sink.stats.dropped_newest || g_sink.stats.dropped_oldest
+			|| g_sink.stats.spilled || g_sink.stats.errors) {
+		sink_print_stats(&g_sink);
+	}
+	if(g_frame_stats.bad) {
+		frame_print_stats();
+	}
+	if(g_capture.fd >= 0) {
+		sink_close(&g_capture);
+		if(g_capture.stats.blocked || g_capture.stats.dropped_newest || g_capture.stats.dropped_oldest
+				|| g_capture.stats.spilled || g_capture.stats.errors) {
+			sink_print_stats(&g_capture);
+		}
+		close(g_capture.fd);
+	}
+	return 0;
+}
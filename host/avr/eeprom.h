@@ -0,0 +1,36 @@
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+//EEPROM contents, erased (0xFF) until the host driver or the firmware writes it
+static uint8_t host_eeprom[1024] __attribute__((unused)) = {[0 ... 1023] = 0xFF};
+
+static inline void eeprom_update_block(const void* src, void* dst, size_t n)
+{
+    memcpy(host_eeprom + (uintptr_t)dst, src, n);
+}
+
+static inline void eeprom_write_block(const void* src, void* dst, size_t n)
+{
+    memcpy(host_eeprom + (uintptr_t)dst, src, n);
+}
+
+static inline void eeprom_read_block(void* dst, const void* src, size_t n)
+{
+    memcpy(dst, host_eeprom + (uintptr_t)src, n);
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t* p)
+{
+    return host_eeprom[(uintptr_t)p];
+}
+
+static inline void eeprom_update_byte(uint8_t* p, uint8_t val)
+{
+    host_eeprom[(uintptr_t)p] = val;
+}
+
+#endif
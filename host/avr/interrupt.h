@@ -0,0 +1,13 @@
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include "io.h"
+
+//ISRs are plain functions the host driver calls, e.g. TIMER2_OVF_vect()
+#define ISR(vector, ...) void vector(void)
+#define ISR_NOBLOCK
+//memory barriers like avr-libc's: data an ISR wrote is read again after them
+#define sei() do { __asm__ __volatile__("" ::: "memory"); SREG |= 1 << SREG_I; } while(0)
+#define cli() do { __asm__ __volatile__("" ::: "memory"); SREG &= ~(1 << SREG_I); } while(0)
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+/*
+Host build (make host-XX): the registers of the ATmega328P and the
+ATtiny2313 as plain variables, so the firmware compiles with gcc and its
+logic runs on the build machine.
+
+Nothing is emulated: a register keeps what was last written, the host
+driver sets inputs (PINB, ADC, TCNT2, ...) and reads outputs directly.
+Busy-waits on flags such as SPIF or TWINT never end, the drivers call
+the functions that do not wait.
+
+Registers the lib/ headers test with #ifdef (UDR0, PRR, PORTx) are also
+defined as macros of the same name.
+*/
+
+#define _BV(bit) (1 << (bit))
+
+#define _REG8(name)  static volatile uint8_t name __attribute__((unused))
+#define _REG16(name) static volatile uint16_t name __attribute__((unused))
+
+#ifdef __AVR_ATtiny2313__
+_REG8(PINA); _REG8(DDRA); _REG8(PORTA);
+#define PORTA PORTA
+#endif
+_REG8(PINB); _REG8(DDRB); _REG8(PORTB);
+_REG8(PINC); _REG8(DDRC); _REG8(PORTC);
+_REG8(PIND); _REG8(DDRD); _REG8(PORTD);
+#define PORTB PORTB
+#define PORTC PORTC
+#define PORTD PORTD
+_REG8(MCUCR); _REG8(MCUSR); _REG8(SREG); _REG8(GPIOR0);
+#define SREG_I 7
+
+/* timers */
+_REG8(TCCR0A); _REG8(TCCR0B); _REG8(TCNT0); _REG8(OCR0A); _REG8(OCR0B);
+_REG8(TCCR1A); _REG8(TCCR1B); _REG8(TCCR1C); _REG16(TCNT1); _REG16(OCR1A); _REG16(OCR1B); _REG16(ICR1);
+_REG8(TCCR2A); _REG8(TCCR2B); _REG8(TCNT2); _REG8(OCR2A); _REG8(OCR2B); _REG8(ASSR);
+
+#if defined(__AVR_ATtiny2313__)
+_REG8(TIMSK); _REG8(TIFR); _REG8(GIMSK); _REG8(PCMSK); _REG8(WDTCSR); _REG8(CLKPR);
+_REG8(UDR); _REG8(UCSRA); _REG8(UCSRB); _REG8(UCSRC); _REG8(UBRRL); _REG8(UBRRH);
+#define RXC  7
+#define TXC  6
+#define UDRE 5
+#define U2X  1
+#define MPCM 0
+#define DOR 3
+#define FE 4
+#define RAMEND 0xDF
+#define RXCIE 7
+#define TXCIE 6
+#define UDRIE 5
+#define RXEN 4
+#define TXEN 3
+#define UCSZ1 2
+#define UCSZ0 1
+#define PCIE 5
+#define PCINT0 0
+#define SE 5
+#define SM0 4
+#define SM1 6
+#define WDIF 7
+#define WDIE 6
+#define WDCE 4
+#define WDE 3
+#define TOIE1 7
+#define OCIE1A 6
+#define TOIE0 1
+#define OCIE0A 0
+#else
+_REG8(TIMSK0); _REG8(TIMSK1); _REG8(TIMSK2); _REG8(TIFR0); _REG8(TIFR1); _REG8(TIFR2);
+_REG8(PCICR); _REG8(PCMSK0); _REG8(PCMSK1); _REG8(PCMSK2); _REG8(PCIFR);
+_REG8(EICRA); _REG8(EIMSK);
+_REG8(SMCR); _REG8(PRR); _REG8(CLKPR); _REG8(WDTCSR);
+_REG8(UDR0); _REG8(UCSR0A); _REG8(UCSR0B); _REG8(UCSR0C); _REG8(UBRR0L); _REG8(UBRR0H); _REG16(UBRR0);
+_REG8(SPCR); _REG8(SPSR); _REG8(SPDR);
+_REG8(TWBR); _REG8(TWSR); _REG8(TWAR); _REG8(TWDR); _REG8(TWCR);
+_REG8(ADMUX); _REG8(ADCSRA); _REG8(ADCSRB); _REG8(ADCL); _REG8(ADCH); _REG16(ADC); _REG8(DIDR0);
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define U2X0 1
+#define MPCM0 0
+#define DOR0 3
+#define FE0 4
+#define RAMEND 0x8FF
+#define UDR0 UDR0
+#define PRR PRR
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+#define UCSZ01 2
+#define UCSZ00 1
+#define SPIE 7
+#define SPE 6
+#define DORD 5
+#define MSTR 4
+#define CPOL 3
+#define CPHA 2
+#define SPR1 1
+#define SPR0 0
+#define SPIF 7
+#define WCOL 6
+#define SPI2X 0
+#define TWINT 7
+#define TWEA 6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC 3
+#define TWEN 2
+#define TWIE 0
+#define INT1 1
+#define INT0 0
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define SM2 3
+#define SM1 2
+#define SM0 1
+#define SE 0
+#define PRTWI 7
+#define PRTIM2 6
+#define PRTIM0 5
+#define PRTIM1 3
+#define PRSPI 2
+#define PRUSART0 1
+#define PRADC 0
+#define WDIF 7
+#define WDIE 6
+#define WDCE 4
+#define WDE 3
+#define TOIE2 0
+#define OCIE2A 1
+#define TOIE1 0
+#define OCIE1A 1
+#define TOIE0 0
+#define OCIE0A 1
+#define AS2 5
+#define TCN2UB 4
+#define OCR2AUB 3
+#define OCR2BUB 2
+#define TCR2AUB 1
+#define TCR2BUB 0
+#define ADEN 7
+#define ADSC 6
+#define ADIE 3
+#define ADIF 4
+#endif
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM2A1 7
+#define COM2B1 5
+#define WGM00 0
+#define WGM01 1
+#define WGM20 0
+#define WGM21 1
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDP3 5
+#define CLKPCE 7
+
+#endif
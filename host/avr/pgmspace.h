@@ -0,0 +1,16 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+//one address space on the host: flash data is ordinary const data
+#define PROGMEM
+#define PGM_P               const char*
+#define PSTR(s)             (s)
+#define memcpy_P            memcpy
+#define pgm_read_byte(p)    (*(const uint8_t*)(p))
+#define pgm_read_word(p)    (*(const uint16_t*)(p))
+#define pgm_read_ptr(p)     (*(void* const*)(p))
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef HOST_AVR_WDT_H
+#define HOST_AVR_WDT_H
+
+#define WDTO_15MS   0
+#define WDTO_1S     6
+#define WDTO_2S     7
+
+#define wdt_reset()
+#define wdt_enable(v)   ((void)(v))
+#define wdt_disable()
+
+#endif
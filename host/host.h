@@ -0,0 +1,38 @@
+#ifndef HOST_HOST_H
+#define HOST_HOST_H
+
+#include <stdio.h>
+#include <time.h>
+
+/*
+Host drivers (host/hostXX.c) include the firmware source itself:
+
+	#define main firmware_main
+	#include "../test05.c"
+	#undef main
+
+so its static functions, ISRs and globals are in scope. Each driver
+checks a few known results, times the hot functions and exits with 1 if
+a check failed.
+*/
+
+static int g_host_failed = 0;
+
+#define HOST_CHECK(cond) do { \
+	if(!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		g_host_failed = 1; \
+	} \
+} while(0)
+
+static double host_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void host_bench_print(const char* name, unsigned long count, double secs) {
+	printf("%-16s %10lu calls  %8.2f ns/call\n", name, count, secs * 1e9 / count);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#define main firmware_main
+#include "../test01.c"
+#undef main
+
+#include "host.h"
+
+//test01 candle: flicker oscillator and the coin (PB0) pin change handler
+
+int main() {
+	//all demonstration candles burn out
+	for(unsigned i = 0; i <= 0x1B0; i ++) {
+		check_candle_times();
+	}
+	HOST_CHECK((PORTD & 0x7F) == 0x7F);
+
+	//coin: PB0 low lights one candle, the next edge is debounced
+	PINB = 0;
+	PCINT_vect();
+	HOST_CHECK(debounce == 0xFF);
+	check_candle_times();
+	HOST_CHECK((PORTD & 0x7F) == 0x3F);
+	PCINT_vect();
+	check_candle_times();
+	HOST_CHECK((PORTD & 0x7F) == 0x3F);
+
+	uint8_t min = 0xFF, max = 0;
+	unsigned long count = 10000000;
+	double start = host_time();
+	for(unsigned long i = 0; i < count; i ++) {
+		uint8_t val = oscilate();
+		min = val < min ? val : min;
+		max = val > max ? val : max;
+	}
+	host_bench_print("oscilate", count, host_time() - start);
+	printf("oscilate         duty %u..%u\n", min, max);
+	//flickers around half duty
+	HOST_CHECK(min < 127 && max > 127);
+	return g_host_failed;
+}
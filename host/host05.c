@@ -0,0 +1,113 @@
+#define main firmware_main
+#include "../test05.c"
+#undef main
+
+#include "host.h"
+
+//test05 RTC: BCD time of day and day counter
+
+static unsigned tm_secs() {
+	return ((tm.d1 * 10 + tm.d0) * 24 + tm.h1 * 10 + tm.h0) * 3600 + (tm.m1 * 10 + tm.m0) * 60 + tm.s1 * 10 + tm.s0;
+}
+
+//lib/power.h: sys_init() gates what test05 does not claim, claims are counted
+static void check_power() {
+	sys_init();
+	uint8_t on = (1 << PRUSART0) | (1 << PRTIM2);
+#ifdef ISR_STAT_SLOTS
+	on |= 1 << PRTIM1;
+#endif
+	HOST_CHECK(PRR == (POWER_ALL & ~on));
+	power_claim(POWER_ADC);
+	power_claim(POWER_ADC);
+	power_release(POWER_ADC);
+	HOST_CHECK(!(PRR & (1 << PRADC)));
+	power_release(POWER_ADC);
+	HOST_CHECK(PRR & (1 << PRADC));
+	power_release(POWER_ADC);
+	power_claim(POWER_ADC);
+	HOST_CHECK(!(PRR & (1 << PRADC)));
+	power_release(POWER_ADC);
+	power_release(POWER_USART0);
+	HOST_CHECK(PRR == (POWER_ALL & ~(1 << PRTIM2) & ~(on & (1 << PRTIM1))));
+}
+
+//lib/power.h governor: the deepest mode the running peripherals allow
+static void check_sleep_mode() {
+	sys_init();
+	ASSR = 1 << AS2;
+	HOST_CHECK(SLEEP_MODE_IDLE == power_sleep_mode());	//UART receiver
+	UCSR0B = 1 << TXEN0;
+	UCSR0A = 0;
+	HOST_CHECK(SLEEP_MODE_IDLE == power_sleep_mode());	//last byte going out
+	UCSR0A = 1 << TXC0;
+	TCCR1B = 0;
+	HOST_CHECK(SLEEP_MODE_PWR_SAVE == power_sleep_mode());
+	ADCSRA = 1 << ADSC;
+	HOST_CHECK(SLEEP_MODE_PWR_SAVE == power_sleep_mode());	//ADC gated
+	power_claim(POWER_ADC);
+	HOST_CHECK(SLEEP_MODE_ADC == power_sleep_mode());
+	ADCSRA = 0;
+	power_release(POWER_ADC);
+	EIMSK = 1 << INT0;
+	EICRA = 0b0011;
+	HOST_CHECK(SLEEP_MODE_IDLE == power_sleep_mode());	//INT0 on an edge
+	EICRA = 0;
+	HOST_CHECK(SLEEP_MODE_PWR_SAVE == power_sleep_mode());
+	EIMSK = 0;
+	ASSR = 0;
+	HOST_CHECK(SLEEP_MODE_IDLE == power_sleep_mode());	//Timer2 on the I/O clock
+	TCCR2B = 0;
+	HOST_CHECK(SLEEP_MODE_PWR_DOWN == power_sleep_mode());
+}
+
+//lib/cmd_line.h: the "t h m s" command line, numbers up to 16 bits only
+static uint8_t feed_line(const char* line) {
+	uint8_t res = CMD_LINE_NONE;
+	while(*line)
+		res = cmd_line_feed(&g_cmd, *line ++);
+	return res;
+}
+
+static void check_cmd_line() {
+	HOST_CHECK(CMD_LINE_READY == feed_line("t 65535 0xffff\r"));
+	HOST_CHECK(2 == g_cmd.argc && 0xFFFF == g_cmd.argv[0] && 0xFFFF == g_cmd.argv[1]);
+	HOST_CHECK(CMD_LINE_ERROR == feed_line("t 65536\r"));
+	HOST_CHECK(CMD_LINE_ERROR == feed_line("t 0x10000\r"));
+	HOST_CHECK(CMD_LINE_ERROR == feed_line("t 99999\r"));
+	HOST_CHECK(CMD_LINE_READY == feed_line("t 0x0\r") && 1 == g_cmd.argc && 0 == g_cmd.argv[0]);
+}
+
+int main() {
+	check_power();
+	check_sleep_mode();
+	check_cmd_line();
+
+	HOST_CHECK(set_time(24, 0, 0));
+	HOST_CHECK(set_time(0, 60, 0));
+	HOST_CHECK(!set_time(23, 59, 59));
+	update_time();
+	HOST_CHECK(tm_secs() == 86400);
+
+	//every second of the 100 days the counter holds, then the wrap to 0
+	reset_time();
+	unsigned long count = 100UL * 86400;
+	for(unsigned long i = 1; i <= count; i ++) {
+		update_time();
+		if(tm_secs() != i % count) {
+			HOST_CHECK(tm_secs() == i % count);
+			break;
+		}
+	}
+
+	double start = host_time();
+	for(unsigned long i = 0; i < count; i ++) {
+		update_time();
+	}
+	host_bench_print("update_time", count, host_time() - start);
+
+	g_rtc_tick = 0;
+	TIMER2_OVF_vect();
+	HOST_CHECK(g_rtc_tick);
+	return g_host_failed;
+}
@@ -0,0 +1,100 @@
+#define main firmware_main
+#include "../test06.c"
+#undef main
+
+#include <string.h>
+
+#include "host.h"
+
+//test06 game: frame rendering and the update step, "host06 -p" prints the first frame,
+//and the lib/spi_async.h transfer the frame goes out with
+
+static uint8_t g_lcd[6][84];
+
+static void render(const struct F_0_OBJ* obj) {
+	struct FRAGMENT frag;
+	for(frag.y = 0; frag.y < 6; frag.y ++) {
+		for(frag.x = 0; frag.x < 84; frag.x ++) {
+			frag.val = 0;
+			f_0_draw(obj, &frag);
+			g_lcd[frag.y][frag.x] = frag.val;
+		}
+	}
+}
+
+static void print_lcd() {
+	for(int row = 0; row < 48; row ++) {
+		for(int x = 0; x < 84; x ++) {
+			putchar(g_lcd[row >> 3][x] & (1 << (row & 7)) ? '#' : '.');
+		}
+		putchar('\n');
+	}
+}
+
+//lib/spi_async.h: the frame out byte by byte, then a command read queued
+//behind it; each ISR call is the end of one byte, SPDR what was sent
+static void check_spi() {
+	static uint8_t out[6 * 84];
+	uint8_t sent[6 * 84 + 8];
+	uint8_t in[3];
+	struct SPI_XFER frame, rd;
+	static const struct SPI_DEV dev2 = SPI_DEV_INIT(PORTD, PD4, 128);
+	int n = 0;
+	for(unsigned i = 0; i < sizeof(out); i ++)
+		out[i] = i * 7;
+	PORTB = 0b000111;
+	PORTD = 1 << PD4;
+	HOST_CHECK(!spi_xfer_write(&frame, &g_lcd_spi, out, sizeof(out), 0));
+	HOST_CHECK(!spi_xfer_read_cmd(&rd, &dev2, 0x42, in, sizeof(in), 0));
+	HOST_CHECK(SPI_BUSY == frame.status && SPI_QUEUED == rd.status && !(PORTB & (1 << PB2)));
+	HOST_CHECK(SPCR == SPI_DIV_SPCR(SPI_CLOCK_DIV));
+	while(SPCR & (1 << SPIE) && n < (int)sizeof(sent)) {
+		sent[n ++] = SPDR;
+		//the second device answers its own index
+		if(SPI_BUSY == rd.status) {
+			HOST_CHECK((PORTB & (1 << PB2)) && !(PORTD & (1 << PD4)) && SPCR == SPI_DIV_SPCR(128));
+			SPDR = n;
+		}
+		SPI_STC_vect();
+	}
+	HOST_CHECK(SPI_DONE == frame.status && SPI_DONE == rd.status);
+	HOST_CHECK(n == sizeof(out) + 1 + sizeof(in));
+	HOST_CHECK(!memcmp(sent, out, sizeof(out)) && 0x42 == sent[sizeof(out)]);
+	HOST_CHECK(in[0] == (uint8_t)(sizeof(out) + 2) && in[2] == (uint8_t)(sizeof(out) + 4));
+	HOST_CHECK((PORTB & (1 << PB2)) && (PORTD & (1 << PD4)) && spi_async_idle());
+	HOST_CHECK(SPCR == ((1 << SPE) | (1 << MSTR) | SPI_SPCR_CLOCK));
+}
+
+int main(int argc, char* argv[]) {
+	struct F_0_OBJ obj = {
+		.col[0].x = 83, .col[0].hole_y = 2, .col[1].x = 41, .col[1].hole_y = 2,
+		.bird.y = 16
+	};
+	render(&obj);
+	if(argc > 1 && !strcmp(argv[1], "-p")) {
+		print_lcd();
+	}
+	//columns 8 pixels wide with a hole row, the bird 4 pixels high at x 7..13
+	HOST_CHECK(g_lcd[0][80] == 0xFF && g_lcd[0][79] == 0 && g_lcd[5][38] == 0xFF);
+	HOST_CHECK(g_lcd[2][81] == 0x81 && g_lcd[2][41] == 0x81);
+	HOST_CHECK(g_lcd[2][7] == 0x3C && g_lcd[2][13] == 0x3C && g_lcd[2][6] == 0);
+
+	//PC0 button released: the bird falls 1 pixel, the columns move left
+	PINC = 0b11;
+	f_0_update(&obj);
+	HOST_CHECK(obj.bird.y == 17 && obj.col[0].x == 82 && obj.col[1].x == 40);
+	//pressed: it flies up 2
+	PINC = 0b10;
+	f_0_update(&obj);
+	HOST_CHECK(obj.bird.y == 15);
+
+	unsigned long count = 20000;
+	double start = host_time();
+	for(unsigned long i = 0; i < count; i ++) {
+		render(&obj);
+		f_0_update(&obj);
+	}
+	host_bench_print("frame", count, host_time() - start);
+	check_spi();
+	return g_host_failed;
+}
@@ -0,0 +1,132 @@
+#define main firmware_main
+#include "../test10.c"
+#undef main
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "host.h"
+
+//test10 effects: lib/fixed.h error bounds against double, and the Q16.16
+//oscillator of effect_0 against the float one it replaced
+
+static double q16(int32_t a) {
+	return a / 65536.0;
+}
+
+static double q8(int16_t a) {
+	return a / 256.0;
+}
+
+//pseudo random Q16.16 within +-lim
+static int32_t rnd_q16(int32_t lim) {
+	return (int32_t)(((uint32_t)random() << 1 ^ (uint32_t)random()) % (2 * (uint32_t)lim + 1)) - lim;
+}
+
+static void check_mul_div() {
+	double e_mul = 0, e_div = 0, e_mul8 = 0, e_div8 = 0;
+	for(int i = 0; i < 1000000; i ++) {
+		int32_t a = rnd_q16(Q16_16(180)), b = rnd_q16(Q16_16(180));
+		e_mul = fmax(e_mul, fabs(q16(q16_mul(a, b)) - q16(a) * q16(b)));
+		if(b && fabs(q16(a) / q16(b)) < 32767)
+			e_div = fmax(e_div, fabs(q16(q16_div(a, b)) - q16(a) / q16(b)));
+		int16_t a8 = a >> 12, b8 = b >> 12;
+		e_mul8 = fmax(e_mul8, fabs(q8(q8_mul(a8, b8)) - q8(a8) * q8(b8)));
+		if(b8 && fabs(q8(a8) / q8(b8)) < 127)
+			e_div8 = fmax(e_div8, fabs(q8(q8_div(a8, b8)) - q8(a8) / q8(b8)));
+	}
+	printf("max error        q16_mul %.2f q16_div %.2f q8_mul %.2f q8_div %.2f steps\n",
+			e_mul * 65536, e_div * 65536, e_mul8 * 256, e_div8 * 256);
+	HOST_CHECK(e_mul <= 0.5 / 65536 && e_div < 1.0 / 65536);
+	HOST_CHECK(e_mul8 <= 0.5 / 256 && e_div8 < 1.0 / 256);
+
+	HOST_CHECK(q16_div(Q16_16(1), 0) == INT32_MAX && q16_div(Q16_16(-1), 0) == INT32_MIN);
+	HOST_CHECK(q16_div(Q16_16(20000), Q16_16(0.5)) == INT32_MAX);
+	HOST_CHECK(q16_recip(Q16_16(-4)) == Q16_16(-0.25));
+	HOST_CHECK(q8_recip(Q8_8(0.5)) == Q8_8(2) && q8_div(Q8_8(100), Q8_8(0.5)) == INT16_MAX);
+}
+
+static void check_sin() {
+	double e = 0, e8 = 0;
+	for(uint32_t a = 0; a < 0x10000; a ++) {
+		double x = sin(a * 2 * M_PI / 65536);
+		e = fmax(e, fabs(q16(q16_sin(a)) - x));
+		e8 = fmax(e8, fabs(q8(q8_sin(a)) - q16(q16_sin(a))));
+		if(q16_cos(a) != q16_sin(a + 0x4000)) {
+			HOST_CHECK(q16_cos(a) == q16_sin(a + 0x4000));
+			break;
+		}
+	}
+	printf("max error        q16_sin %.2g, q8_sin over q16_sin %.2f steps\n", e, e8 * 256);
+	HOST_CHECK(e <= 1e-4 && e8 <= 0.5 / 256);
+	HOST_CHECK(q16_sin(Q_DEG(90)) == Q16_ONE && q16_sin(Q_DEG(270)) == -Q16_ONE);
+	HOST_CHECK(abs(q16_sin(Q_DEG(30)) - Q16_16(0.5)) <= 7);
+}
+
+//effect_0 channel 0, 20000 steps (about 32 periods): the float and the
+//Q16.16 version against the same recurrence in double
+static void check_oscillator() {
+	double ds = 0, dc = 30, df = q16(Q16_16(0.01));
+	float fs = 0, fc = 30, ff = df;
+	int32_t s = 0, c = Q16_16(30), f = Q16_16(0.01);
+	double e_float = 0, e_q16 = 0;
+	for(int i = 0; i < 20000; i ++) {
+		dc -= ds * df;
+		ds += dc * df;
+		fc -= fs * ff;
+		fs += fc * ff;
+		c -= q16_mul(s, f);
+		s += q16_mul(c, f);
+		e_float = fmax(e_float, fabs(fs - ds));
+		e_q16 = fmax(e_q16, fabs(q16(s) - ds));
+	}
+	printf("effect_0         max error float %.2g, Q16.16 %.2g\n", e_float, e_q16);
+	HOST_CHECK(e_q16 < 0.01);
+}
+
+static void bench() {
+	enum { N = 1 << 20 };
+	static int32_t a[N], b[N];
+	static float fa[N], fb[N];
+	for(int i = 0; i < N; i ++) {
+		a[i] = rnd_q16(Q16_16(100));
+		b[i] = rnd_q16(Q16_16(100)) | 1;
+		fa[i] = q16(a[i]);
+		fb[i] = q16(b[i]);
+	}
+	volatile int32_t sink = 0;
+	volatile float fsink = 0;
+	double start = host_time();
+	for(int i = 0; i < N; i ++)
+		sink += q16_mul(a[i], b[i]);
+	host_bench_print("q16_mul", N, host_time() - start);
+	start = host_time();
+	for(int i = 0; i < N; i ++)
+		fsink += fa[i] * fb[i];
+	host_bench_print("float mul", N, host_time() - start);
+	start = host_time();
+	for(int i = 0; i < N; i ++)
+		sink += q16_div(a[i], b[i]);
+	host_bench_print("q16_div", N, host_time() - start);
+	start = host_time();
+	for(int i = 0; i < N; i ++)
+		fsink += fa[i] / fb[i];
+	host_bench_print("float div", N, host_time() - start);
+	start = host_time();
+	for(int i = 0; i < N; i ++)
+		sink += q16_sin(a[i]);
+	host_bench_print("q16_sin", N, host_time() - start);
+	start = host_time();
+	for(int i = 0; i < N; i ++)
+		fsink += sinf(fa[i]);
+	host_bench_print("sinf", N, host_time() - start);
+}
+
+int main() {
+	check_mul_div();
+	check_sin();
+	check_oscillator();
+	//an FPU makes float as fast as the integers here, AVR cycles: "make 12_fixed_bench"
+	bench();
+	return g_host_failed;
+}
@@ -0,0 +1,103 @@
+#define main firmware_main
+#include "../test12.c"
+#undef main
+
+#include "host.h"
+
+//test12 clock governor: the UART and TWI settings of every prescaler,
+//claims and the delays at the divided clock; text printed before uart_init()
+
+static void check_rates() {
+	struct CLOCK_RATE rate;
+	HOST_CHECK(1 == CLOCK_UART_DIV && 1 == CLOCK_SLOW_DIV);	//38400 baud down to 4 MHz
+	for(uint8_t n = 0; n <= 8; n ++) {
+		memcpy_P(&rate, &clock_rates[n], sizeof(rate));
+		unsigned long f = F_CPU >> n;
+		double baud = 0;
+		if(n <= CLOCK_UART_DIV) {
+			baud = (double)f / ((rate.u2x ? 8 : 16) * (rate.ubrr + 1.0));
+			HOST_CHECK(baud > UART_BAUD * 0.98 && baud < UART_BAUD * 1.02);
+		} else
+			HOST_CHECK(0xFFFF == rate.ubrr);
+		printf("F_CPU >> %u %7lu Hz  UART %6.0f baud  SCL %6lu Hz\n", n, f, baud, f / (16 + 2 * rate.twbr));
+		//SCL = f / (16 + 2 * TWBR), at most TWI_FREQ
+		HOST_CHECK(f / (16 + 2 * rate.twbr) <= TWI_FREQ + TWI_FREQ / 10);
+	}
+	memcpy_P(&rate, &clock_rates[0], sizeof(rate));
+	HOST_CHECK(TWI_TWBR == rate.twbr);
+}
+
+//a print before uart_init() stays queued, the init must not drop UDRIE
+static void check_early_print() {
+	uart_tx('x');
+	uart_init(0);
+	HOST_CHECK(UCSR0B & (1 << UDRIE0));
+	while(UCSR0B & (1 << UDRIE0))
+		USART_UDRE_vect();
+	HOST_CHECK('x' == UDR0 && uart_tx_head == uart_tx_tail);
+	uart_tx_flush();
+	uart_init(1);
+	HOST_CHECK(!(UCSR0B & (1 << UDRIE0)));
+}
+
+//sys_init() without its greeting: nothing on the host drains the UART ring
+static void check_claims() {
+	uart_init(1);
+	twi_init();
+	clock_claim();
+	HOST_CHECK(0 == CLKPR && 0 == clock_div);
+	uint16_t ubrr_fast = UBRR0H << 8 | UBRR0L;
+	clock_release();
+	HOST_CHECK(CLOCK_SLOW_DIV == CLKPR && CLOCK_SLOW_DIV == clock_div);
+	HOST_CHECK((UBRR0H << 8 | UBRR0L) != ubrr_fast || (UCSR0A & (1 << U2X0)));
+	clock_release();
+	clock_claim();
+	HOST_CHECK(0 == CLKPR && (UBRR0H << 8 | UBRR0L) == ubrr_fast && TWI_TWBR == TWBR);
+	clock_claim();
+	clock_release();
+	HOST_CHECK(0 == CLKPR);
+	//the 5 s of the clock test at 31250 Hz: 4-cycle loops
+	clock_set(8);
+	HOST_CHECK(clock_delay_loops(5000) * 4 == 156248);
+	clock_set(0);
+	HOST_CHECK(clock_delay_loops(5000) * 4 == 40000000);
+}
+
+//no switch under received bytes: unread ones keep F_CPU, a claim at F_CPU
+//leaves the baud generator alone
+static void check_rx() {
+	PIND = 1 << PD0;	//RXD idle
+	clock_release();
+	HOST_CHECK(CLOCK_SLOW_DIV == clock_div && 0 == clock_refs);
+	clock_claim();
+	UBRR0L = 0xAA;
+	clock_release();
+	clock_claim();
+	HOST_CHECK(0 == clock_div && 0xAA != UBRR0L);
+	clock_release();
+	clock_claim();
+	UBRR0L = 0xAA;
+	uart_rx_ring[uart_rx_head] = 'x';
+	uart_rx_head = (uart_rx_head + 1) & UART_RX_RING_MASK;
+	clock_release();
+	HOST_CHECK(0 == clock_div && 0 == clock_refs && 0xAA == UBRR0L);
+	clock_claim();
+	HOST_CHECK(0 == clock_div && 0xAA == UBRR0L);
+	uart_rx_tail = uart_rx_head;
+	//RXD low with the receiver on: a frame is waited
+	HOST_CHECK(!clock_rx_busy());
+	PIND = 0;
+	HOST_CHECK(clock_rx_busy());
+	PIND = 1 << PD0;
+	clock_release();
+	HOST_CHECK(CLOCK_SLOW_DIV == clock_div);
+	clock_claim();
+}
+
+int main() {
+	check_rates();
+	check_early_print();
+	check_claims();
+	check_rx();
+	return g_host_failed;
+}
@@ -0,0 +1,233 @@
+#define main firmware_main
+#include "../test14.c"
+#undef main
+
+#include "../lib/bmp180.h"
+#include "host.h"
+
+//test14 BMP180: the compensation its raw readings go through on the host (lib/bmp180.h)
+//against the arithmetic test14 ran before it moved there,
+//the lib/soft_timer.h timers its main loop sleeps on and the lib/twi_async.h
+//transfers it reads the sensor with
+
+//the compensation of the original test14, expression for expression, with
+//the AVR types: int and short 16 bit, long 32 bit. The casts to int16_t
+//stand for int expressions, the rest was long arithmetic already; long
+//overflows wrap on the AVR, -fwrapv here
+__attribute__((optimize("wrapv")))
+static void bmp180_avr(const struct BMP180_CAL* c, uint16_t raw_ut, int32_t up, struct BMP180_RESULT* res) {
+	int32_t ut = (int16_t)raw_ut;	//long ut = buff[0] << 8 | buff[1];
+	int32_t x1, x2, x3, b3, b5, b6, p;
+	uint32_t b4, b7;
+	x1 = (ut - c->ac6) * c->ac5 >> 15;
+	x2 = (int16_t)(c->mc * 2048) / (x1 + c->md);	//(mc << 11) / (x1 + md)
+	b5 = x1 + x2;
+	res->t = (b5 + 8) >> 4;	//float t, printed / 10
+
+	b6 = b5 - 4000;
+	x1 = (c->b2 * (b6 * b6 >> 12)) >> 11;
+	x2 = c->ac2 * b6 >> 11;
+	x3 = x1 + x2;
+	b3 = ((((int16_t)(c->ac1 * 4) + x3) << 3) + 2) >> 2;
+	x1 = c->ac3 * b6 >> 13;
+	x2 = (c->b1 * (b6 * b6 >> 12)) >> 16;
+	x3 = (x1 + x2 + 2) >> 2;
+	b4 = (c->ac4 * (x3 + 32768)) >> 15;
+	b7 = (up - b3) * (50000 >> 3);
+
+	if(b7 < 0x80000000)
+		p = (b7 << 1) / b4;
+	else
+		p = (b7 / b4) << 1;
+
+	x1 = (p >> 8) * (p >> 8);
+	x1 = (x1 * 3038) >> 16;
+	x2 = (-7357 * p) >> 16;
+	p += ((x1 + x2 + 3791) >> 4);
+	res->p = p;
+}
+
+//host result equals the original one and the value given
+static int bmp180_same(const struct BMP180_CAL* cal, uint16_t ut, int32_t up, int16_t t, int32_t p) {
+	struct BMP180_RESULT res, avr;
+	bmp180_compensate(cal, ut, up, &res);
+	bmp180_avr(cal, ut, up, &avr);
+	if(res.t != avr.t || res.p != avr.p || res.t != t || res.p != p) {
+		fprintf(stderr, "bmp180 ut %u up %d: host %d %d, avr %d %d, expected %d %d\n",
+				ut, up, res.t, res.p, avr.t, avr.p, t, p);
+		return 0;
+	}
+	return 1;
+}
+
+static void check_bmp180(const struct BMP180_CAL* cal) {
+	struct BMP180_CAL wrap;
+	struct BMP180_RESULT res, avr;
+	//datasheet example, 29.6 C with the mc << 11 wrap of the AVR
+	HOST_CHECK(bmp180_same(cal, 27898, 23843 << BMP180_OSS, 296, 72269));
+	//ut above 32767 is a negative int
+	HOST_CHECK(bmp180_same(cal, 33000, 23843 << BMP180_OSS, -3479, 42079));
+	//ac1 * 4 above 32767 wraps
+	wrap = *cal;
+	wrap.ac1 = 9000;
+	HOST_CHECK((int16_t)(wrap.ac1 * 4) < 0);
+	HOST_CHECK(bmp180_same(&wrap, 27898, 23843 << BMP180_OSS, 296, 96316));
+	//mc << 11 fits in an int for |mc| < 16 only: no wrap, then a positive one
+	wrap = *cal;
+	wrap.mc = -15;
+	HOST_CHECK(bmp180_same(&wrap, 27898, 23843 << BMP180_OSS, 296, 72265));
+	wrap.mc = 8711;
+	HOST_CHECK((int16_t)(wrap.mc * 2048) != wrap.mc * 2048);
+	HOST_CHECK(bmp180_same(&wrap, 27898, 23843 << BMP180_OSS, 297, 72272));
+	//every ut, a range of up
+	int fails = 0;
+	for(uint32_t ut = 0; ut < 0x10000; ut += 7) {
+		for(int32_t up = 10000 << BMP180_OSS; up < 60000 << BMP180_OSS; up += 9973) {
+			bmp180_compensate(cal, ut, up, &res);
+			bmp180_avr(cal, ut, up, &avr);
+			fails += res.t != avr.t || res.p != avr.p;
+		}
+	}
+	HOST_CHECK(!fails);
+}
+
+static int g_shots = 0;
+
+static void count_shot() {
+	g_shots ++;
+}
+
+static void check_timers() {
+	HOST_CHECK(TIMER_MS(1000) == 63 && TIMER_MS(500) == 31);
+	//periodic: first after 3 ticks, then every 2
+	timer_start(0, 3, 2, count_shot);
+	for(int i = 0; i < 9; i ++)
+		WDT_vect();
+	timer_run();
+	HOST_CHECK(g_shots == 1);	//due 4 times, one run pending in between
+	g_shots = 0;
+	for(int i = 0; i < 2; i ++) {
+		WDT_vect();
+		WDT_vect();
+		timer_wait();
+	}
+	HOST_CHECK(g_shots == 2);
+	timer_stop(0);
+	//one-shot
+	timer_start(1, 2, 0, count_shot);
+	for(int i = 0; i < 10; i ++) {
+		WDT_vect();
+		timer_run();
+	}
+	HOST_CHECK(g_shots == 3);
+}
+
+//lib/twi_async.h against a simulated register device at 0xEE: each step
+//answers what the ISR last wrote to TWCR and TWDR, as the TWI would
+static uint8_t g_sim_regs[256];
+static uint8_t g_sim_mode = 0;	//0 - idle, 1 - address, 2 - register and write data, 3 - read data
+static uint8_t g_sim_first = 0;
+static uint8_t g_sim_ptr = 0;
+
+static void twi_sim_step() {
+	uint8_t cr = TWCR;
+	if(cr & (1 << TWSTA)) {
+		TWSR = g_sim_mode && !(cr & (1 << TWSTO)) ? TW_REP_START : TW_START;
+		g_sim_mode = 1;
+	} else if(1 == g_sim_mode) {
+		if((TWDR & 0xFE) != BMP180_ADDRESS)
+			TWSR = TWDR & 1 ? TW_MR_SLA_NACK : TW_MT_SLA_NACK;
+		else if(TWDR & 1) {
+			g_sim_mode = 3;
+			TWSR = TW_MR_SLA_ACK;
+		} else {
+			g_sim_mode = 2;
+			g_sim_first = 1;
+			TWSR = TW_MT_SLA_ACK;
+		}
+	} else if(2 == g_sim_mode) {
+		if(g_sim_first)
+			g_sim_ptr = TWDR;
+		else
+			g_sim_regs[g_sim_ptr ++] = TWDR;
+		g_sim_first = 0;
+		TWSR = TW_MT_DATA_ACK;
+	} else {
+		TWDR = g_sim_regs[g_sim_ptr ++];
+		TWSR = cr & (1 << TWEA) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+	}
+	TWI_vect();
+	//a lone STOP ends the traffic, the TWI clears TWSTO once sent
+	if((TWCR & (1 << TWSTO)) && !(TWCR & (1 << TWSTA))) {
+		TWCR = 1 << TWEN;
+		g_sim_mode = 0;
+	}
+}
+
+static int g_twi_done = 0;
+
+static void count_twi_done(struct TWI_XFER* x) {
+	g_twi_done ++;
+}
+
+static void check_twi() {
+	struct TWI_XFER wr, rd, missing, extra;
+	uint8_t out[2] = {0x12, 0x34};
+	uint8_t in[3] = {0};
+	g_sim_regs[0x12] = 0x56;
+	HOST_CHECK(!i2c_write_reg_async(&wr, BMP180_ADDRESS, 0x10, out, 2, count_twi_done));
+	HOST_CHECK(!i2c_read_reg_async(&rd, BMP180_ADDRESS, 0x10, in, 3, count_twi_done));
+	HOST_CHECK(!i2c_read_reg_async(&missing, 0x90, 0x00, in, 1, count_twi_done));
+	//4 slots, one kept free
+	HOST_CHECK(i2c_read_reg_async(&extra, BMP180_ADDRESS, 0x00, in, 1, 0));
+	for(int i = 0; i < 100 && TWCR & (1 << TWIE); i ++)
+		twi_sim_step();
+	HOST_CHECK(TWI_DONE == wr.status && TWI_DONE == rd.status && TWI_ERROR == missing.status);
+	HOST_CHECK(3 == g_twi_done);
+	HOST_CHECK(0x12 == in[0] && 0x34 == in[1] && 0x56 == in[2]);
+	//queue empty again: a new transfer starts at once
+	HOST_CHECK(!i2c_read_reg_async(&rd, BMP180_ADDRESS, 0x11, in, 1, 0));
+	HOST_CHECK(TWI_BUSY == rd.status && (TWCR & (1 << TWSTA)));
+	for(int i = 0; i < 100 && TWCR & (1 << TWIE); i ++)
+		twi_sim_step();
+	HOST_CHECK(TWI_DONE == rd.status && 0x34 == in[0]);
+}
+
+int main() {
+	//datasheet p. 15 calibration
+	const struct BMP180_CAL cal = {
+		.ac1 = 408, .ac2 = -72, .ac3 = -14383, .ac4 = 32741, .ac5 = 32757, .ac6 = 23153,
+		.b1 = 6190, .b2 = 4, .mb = -32768, .mc = -8711, .md = 2868
+	};
+	struct BMP180_RESULT res, prev = {0};
+
+	check_timers();
+	check_twi();
+	check_bmp180(&cal);
+
+	//raw counts rise with temperature and pressure, so must the results.
+	//ut above 32767 (about 60 C here) is negative as the 16-bit int of
+	//the original firmware, the temperature jumps to -350 C
+	for(uint16_t ut = 24000; ut < 32768; ut += 100) {
+		bmp180_compensate(&cal, ut, 23843 << BMP180_OSS, &res);
+		HOST_CHECK(ut == 24000 || res.t >= prev.t);
+		prev = res;
+	}
+	for(int32_t up = 20000 << BMP180_OSS; up < 50000 << BMP180_OSS; up += 1000) {
+		bmp180_compensate(&cal, 27898, up, &res);
+		HOST_CHECK(up == 20000 << BMP180_OSS || res.p > prev.p);
+		prev = res;
+	}
+	bmp180_compensate(&cal, 27898, 23843 << BMP180_OSS, &res);
+	printf("bmp180           ut 27898 up %d: %.1f C %d Pa\n", 23843 << BMP180_OSS, res.t / 10.0, res.p);
+
+	unsigned long count = 10000000;
+	volatile int32_t sink = 0;
+	double start = host_time();
+	for(unsigned long i = 0; i < count; i ++) {
+		bmp180_compensate(&cal, 27898 + (i & 0xFF), (23843 << BMP180_OSS) + (i & 0xFFF), &res);
+		sink += res.p;
+	}
+	host_bench_print("compensate", count, host_time() - start);
+	return g_host_failed;
+}
@@ -0,0 +1,8 @@
+#ifndef HOST_UTIL_DELAY_BASIC_H
+#define HOST_UTIL_DELAY_BASIC_H
+
+//delays take no time on the host
+#define _delay_loop_1(n)    ((void)(n))
+#define _delay_loop_2(n)    ((void)(n))
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef LIB_BAUD_SWITCH_H
+#define LIB_BAUD_SWITCH_H
+
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+#include "uart_baud.h"
+#include "uart_tx.h"
+#include "uart_rx.h"
+#include "cmd_line.h"
+#include "print.h"
+
+/*
+Host initiated baud rate switch, the other end is "client -d tty -u".
+
+    host                        firmware
+    "baud N" (N = rate / 100)   ->
+                                <-  "baud ok" at the old rate, or "baud err"
+    switches to the new rate
+    "baud"                      ->  at the new rate, within BAUD_SWITCH_TIMEOUT_MS
+                                <-  "baud ok" at the new rate
+
+Without the confirmation both sides go back to the old rate, so a rate
+the cable or the clocks do not carry costs one timeout. The host tries
+its rates from the fastest down.
+
+The firmware offers the standard rates that F_CPU reaches within
+UART_BAUD_TOL, the table is filtered at compile time. Above 250000 baud
+at 8 MHz a byte takes 160 cycles or less: long ISRs elsewhere show up in
+uart_rx_overruns.
+
+Options, define before including:
+    BAUD_SWITCH_TIMEOUT_MS - default 1000
+*/
+
+#ifndef BAUD_SWITCH_TIMEOUT_MS
+#define BAUD_SWITCH_TIMEOUT_MS  1000
+#endif
+
+struct BAUD_SWITCH_RATE {
+    uint16_t rate100;   //0 - not reachable from F_CPU
+    uint16_t ubrr;
+    uint8_t u2x;
+};
+
+#define BAUD_SWITCH_RATE(b) { \
+    UART_BAUD_OK(F_CPU, b) ? (b) / 100 : 0, \
+    UART_BAUD_OK(F_CPU, b) ? UART_UBRR(F_CPU, b, UART_U2X(F_CPU, b)) : 0, \
+    UART_U2X(F_CPU, b) \
+}
+
+static const struct BAUD_SWITCH_RATE baud_switch_rates[] PROGMEM = {
+    BAUD_SWITCH_RATE(9600UL),
+    BAUD_SWITCH_RATE(19200UL),
+    BAUD_SWITCH_RATE(38400UL),
+    BAUD_SWITCH_RATE(57600UL),
+    BAUD_SWITCH_RATE(115200UL),
+    BAUD_SWITCH_RATE(230400UL),
+    BAUD_SWITCH_RATE(250000UL),
+    BAUD_SWITCH_RATE(500000UL),
+    BAUD_SWITCH_RATE(1000000UL),
+};
+
+//"baud" received at the new rate before the timeout
+static inline uint8_t baud_switch_confirmed()
+{
+    struct CMD_LINE cl = {.len = 0};
+    uint8_t ch;
+    //bytes sent by the host before it switched
+    while(uart_rx_read(&ch));
+    for(uint16_t ms = 0; ms < BAUD_SWITCH_TIMEOUT_MS; ms ++) {
+        while(uart_rx_read(&ch)) {
+            if(CMD_LINE_READY == cmd_line_feed(&cl, ch) && cmd_line_is_P(&cl, PSTR("baud")) && !cl.argc)
+                return 1;
+        }
+        _delay_ms(1);
+    }
+    return 0;
+}
+
+//the "baud N" command; returns 0 if the rate was switched
+static inline uint8_t baud_switch(uint16_t rate100)
+{
+    struct BAUD_SWITCH_RATE rate;
+    uint8_t i = 0;
+    do {
+        if(sizeof(baud_switch_rates) / sizeof(baud_switch_rates[0]) == i) {
+            p_line_P(PSTR("baud err"));
+            return 1;
+        }
+        memcpy_P(&rate, &baud_switch_rates[i ++], sizeof(rate));
+    } while(!rate100 || rate.rate100 != rate100);
+
+    uint16_t ubrr = UART_BAUD_UBRRH << 8 | UART_BAUD_UBRRL;
+    uint8_t u2x = !!(UART_BAUD_UCSRA & (1 << UART_BAUD_U2X));
+    p_line_P(PSTR("baud ok"));
+    uart_tx_flush();
+    uart_baud_set(rate.ubrr, rate.u2x);
+    if(!baud_switch_confirmed()) {
+        uart_baud_set(ubrr, u2x);
+        return 1;
+    }
+    p_line_P(PSTR("baud ok"));
+    return 0;
+}
+
+#endif
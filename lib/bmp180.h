@@ -0,0 +1,107 @@
+#ifndef LIB_BMP180_H
+#define LIB_BMP180_H
+
+#include <stdint.h>
+
+/*
+BMP180 compensation, shared by the firmware and the host (client.c).
+
+https://cdn-shop.adafruit.com/datasheets/BST-BMP180-DS000-09.pdf, p. 15
+
+The arithmetic repeats what test14 used to do on the ATmega328P step by
+step: int is 16 bit, long is 32 bit and overflows wrap. All widths are
+explicit here, so a 64-bit host gets bit-identical results.
+
+NOTE: "mc << 11" is a 16-bit int expression on the AVR and wraps for the
+usual mc values, so x2 differs from the datasheet. Kept as is to match the
+device output.
+*/
+
+//oversampling setting used by test14 (0xF4 command 0x34 + (3 << 6))
+#define BMP180_OSS      3
+
+//calibration registers 0xAA..0xBF
+#define BMP180_CAL_LEN  22
+
+struct BMP180_CAL {
+    int16_t ac1, ac2, ac3;
+    uint16_t ac4, ac5, ac6;
+    int16_t b1, b2, mb, mc, md;
+};
+
+struct BMP180_RESULT {
+    int16_t t;  //0.1 C
+    int32_t p;  //Pa
+};
+
+static inline void bmp180_parse_cal(struct BMP180_CAL* cal, const uint8_t buff[BMP180_CAL_LEN])
+{
+    cal->ac1 = buff[0]  << 8 | buff[1];
+    cal->ac2 = buff[2]  << 8 | buff[3];
+    cal->ac3 = buff[4]  << 8 | buff[5];
+    cal->ac4 = buff[6]  << 8 | buff[7];
+    cal->ac5 = buff[8]  << 8 | buff[9];
+    cal->ac6 = buff[10] << 8 | buff[11];
+    cal->b1  = buff[12] << 8 | buff[13];
+    cal->b2  = buff[14] << 8 | buff[15];
+    cal->mb  = buff[16] << 8 | buff[17];
+    cal->mc  = buff[18] << 8 | buff[19];
+    cal->md  = buff[20] << 8 | buff[21];
+}
+
+//32-bit long multiply and left shift with AVR wrap-around
+static inline int32_t bmp180_mul(int32_t a, int32_t b)
+{
+    return (int32_t)((uint32_t)a * (uint32_t)b);
+}
+
+static inline int32_t bmp180_shl(int32_t a, uint8_t n)
+{
+    return (int32_t)((uint32_t)a << n);
+}
+
+//ut - raw 16-bit temperature (0xF6, 0xF7), up - raw pressure >> (8 - BMP180_OSS)
+static inline void bmp180_compensate(const struct BMP180_CAL* cal, uint16_t ut, int32_t up,
+        struct BMP180_RESULT* res)
+{
+    int32_t x1, x2, x3, b3, b5, b6, p, div;
+    uint32_t b4, b7;
+
+    //calculate true temperature
+    //(long)(buff[0] << 8 | buff[1]) sign-extends a 16-bit int
+    x1 = bmp180_mul((int16_t)ut - (int32_t)cal->ac6, cal->ac5) >> 15;
+    div = x1 + cal->md;
+    //the AVR returns garbage on division by zero, the host would trap
+    x2 = div ? (int16_t)(uint16_t)((uint16_t)cal->mc << 11) / div : 0;
+    b5 = x1 + x2;
+    res->t = (b5 + 8) >> 4;
+
+    //calculate true pressure
+    b6 = b5 - 4000;
+    x1 = bmp180_mul(cal->b2, bmp180_mul(b6, b6) >> 12) >> 11;
+    x2 = bmp180_mul(cal->ac2, b6) >> 11;
+    x3 = x1 + x2;
+    b3 = (bmp180_shl((int16_t)(uint16_t)(cal->ac1 * 4) + x3, BMP180_OSS) + 2) >> 2;
+    x1 = bmp180_mul(cal->ac3, b6) >> 13;
+    x2 = bmp180_mul(cal->b1, bmp180_mul(b6, b6) >> 12) >> 16;
+    x3 = (x1 + x2 + 2) >> 2;
+    b4 = bmp180_mul(cal->ac4, x3 + 32768) >> 15;
+    b7 = bmp180_mul(up - b3, 50000 >> BMP180_OSS);
+    if(!b4) {
+        res->p = 0;
+        return;
+    }
+
+    if(b7 < 0x80000000)
+        p = (b7 << 1) / b4;
+    else
+        p = (b7 / b4) << 1;
+
+    x1 = bmp180_mul(p >> 8, p >> 8);
+    x1 = bmp180_mul(x1, 3038) >> 16;
+    x2 = bmp180_mul(-7357, p) >> 16;
+    p += ((x1 + x2 + 3791) >> 4);
+    res->p = p;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef LIB_CLOCK_H
+#define LIB_CLOCK_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay_basic.h>
+
+#include "uart_baud.h"
+#include "uart_tx.h"
+
+/*
+CPU clock scaling with the CLKPR prescaler: the clock drops while
+nothing holds it and goes back to F_CPU for the work in between, the
+way test12 measured 3.74 mA at 8 MHz and 0.74 mA at 1 MHz (3.3 V).
+
+    clock_init();               //slow from here on
+    ...
+    clock_claim();              //F_CPU: SPI and TWI bursts, math
+    f_measure();
+    clock_release();            //back to CLOCK_SLOW_DIV
+    wait_for_event();           //idle sleep, the I/O clock divided too
+
+Claims are counted like the ones of lib/power.h; clock_init() writes
+CLKPR over what the CKDIV8 fuse left, claims and releases only switch
+away from the prescaler clock_div holds. clock_set() changes the
+prescaler at once, for measurements: the governor takes over again at
+the next claim or release.
+
+On every change the UART divisor is taken from a table built at compile
+time for each prescaler (lib/uart_baud.h), and so is TWBR for TWI_FREQ
+when lib/twi.h is included first. At prescalers where UART_BAUD is out
+of UART_BAUD_TOL, the UART keeps its last divisor and is unusable; where
+TWI_FREQ is out of reach TWI runs at the fastest SCL it has, F / 16.
+The default CLOCK_SLOW_DIV is the slowest clock the UART still works
+at: 4 MHz for 38400 baud from 8 MHz.
+
+Not scaled: SPI SCK is SPI_CLOCK_DIV of the current clock, Timer0 and
+Timer1 count the current clock, _delay_ms() and _delay_us() are compiled
+for F_CPU; use clock_delay_ms(). Timer2 on the 32 kHz crystal and the
+WDT run on their own oscillators and are not affected.
+
+clock_set() flushes the UART TX first. A switch under a byte being
+received loses it: with RXD low (a start or 0 bit) clock_set() waits one
+frame time first, and clock_release() keeps F_CPU while received bytes
+wait in the lib/uart_rx.h ring (included first), typed ahead or still
+coming. A byte whose bits on RXD are 1 at the check is not seen, nor is
+one that starts in the frame time waited: typed keys are milliseconds
+apart, pasted text can lose a byte at a switch. Not for ISRs, and not
+while lib/twi_async.h or lib/spi_async.h transfers run.
+
+Options, define before including:
+    CLOCK_SLOW_DIV - prescaler while nothing claims the clock,
+                     F_CPU >> CLOCK_SLOW_DIV, 0..8
+*/
+
+//slowest prescaler the UART reaches UART_BAUD at
+#define CLOCK_UART_OK(n)    UART_BAUD_OK(F_CPU >> (n), UART_BAUD)
+#define CLOCK_UART_DIV      (!CLOCK_UART_OK(1) ? 0 : !CLOCK_UART_OK(2) ? 1 : !CLOCK_UART_OK(3) ? 2 \
+                            : !CLOCK_UART_OK(4) ? 3 : !CLOCK_UART_OK(5) ? 4 : !CLOCK_UART_OK(6) ? 5 \
+                            : !CLOCK_UART_OK(7) ? 6 : !CLOCK_UART_OK(8) ? 7 : 8)
+
+#ifndef CLOCK_SLOW_DIV
+#define CLOCK_SLOW_DIV      CLOCK_UART_DIV
+#endif
+
+#if CLOCK_SLOW_DIV > 8
+#error "CLOCK_SLOW_DIV 0..8"
+#endif
+
+struct CLOCK_RATE {
+    uint16_t ubrr;      //0xFFFF - UART_BAUD out of reach
+    uint8_t u2x;
+    uint8_t twbr;
+};
+
+#ifdef TWI_TWBR
+#define CLOCK_TWBR(f)       ((f) / TWI_FREQ >= 16 ? ((f) / TWI_FREQ - 16) / 2 : 0)
+#else
+#define CLOCK_TWBR(f)       0
+#endif
+
+#define CLOCK_RATE(n) { \
+    CLOCK_UART_OK(n) ? UART_UBRR(F_CPU >> (n), UART_BAUD, UART_U2X(F_CPU >> (n), UART_BAUD)) : 0xFFFF, \
+    UART_U2X(F_CPU >> (n), UART_BAUD), \
+    CLOCK_TWBR(F_CPU >> (n)) \
+}
+
+static const struct CLOCK_RATE clock_rates[9] PROGMEM = {
+    CLOCK_RATE(0), CLOCK_RATE(1), CLOCK_RATE(2), CLOCK_RATE(3), CLOCK_RATE(4),
+    CLOCK_RATE(5), CLOCK_RATE(6), CLOCK_RATE(7), CLOCK_RATE(8),
+};
+
+#ifdef UDR0
+#define CLOCK_RXEN          RXEN0
+#else
+#define CLOCK_RXEN          RXEN
+#endif
+
+//current prescaler, F_CPU >> clock_div
+static uint8_t clock_div = 0;
+static uint8_t clock_refs = 0;
+
+//n 4-cycle loops
+static inline void clock_delay_loops_run(uint32_t n)
+{
+    for(; n > 0xFFFF; n -= 0xFFFF)
+        _delay_loop_2(0xFFFF);
+    if(n)
+        _delay_loop_2(n);
+}
+
+//receiver on and RXD (PD0 on the ATmega328P and the ATtiny2313) low
+static inline uint8_t clock_rx_busy()
+{
+    return UART_TX_UCSRB & (1 << CLOCK_RXEN) && !(PIND & (1 << PD0));
+}
+
+//one frame of 10 bits at the current divisor: the byte on RXD ends in it
+static inline void clock_rx_wait()
+{
+    if(!clock_rx_busy())
+        return;
+    uint16_t ubrr = UART_BAUD_UBRRH << 8 | UART_BAUD_UBRRL;
+    uint8_t bit = UART_BAUD_UCSRA & (1 << UART_BAUD_U2X) ? 8 : 16;
+    clock_delay_loops_run((uint32_t)(ubrr + 1) * bit * 10 / 4);
+}
+
+//n - 0..8, F_CPU >> n
+static inline void clock_set(uint8_t n)
+{
+    struct CLOCK_RATE rate;
+    memcpy_P(&rate, &clock_rates[n], sizeof(rate));
+    uart_tx_flush();
+    clock_rx_wait();
+    uint8_t sreg = SREG;
+    cli();
+    //the two writes within 4 cycles
+    CLKPR = 1 << CLKPCE;
+    CLKPR = n;
+    clock_div = n;
+    if(0xFFFF != rate.ubrr)
+        uart_baud_set(rate.ubrr, rate.u2x);
+#ifdef TWI_TWBR
+    TWBR = rate.twbr;
+#endif
+    SREG = sreg;
+}
+
+static inline void clock_init()
+{
+    clock_set(clock_refs ? 0 : CLOCK_SLOW_DIV);
+}
+
+//a UBRR write restarts the baud generator: no switch to the clock running
+static inline void clock_claim()
+{
+    if(!clock_refs ++ && clock_div)
+        clock_set(0);
+}
+
+//a release without a claim is ignored; with received bytes not read yet
+//the clock stays at F_CPU until the next release
+static inline void clock_release()
+{
+    if(!clock_refs || -- clock_refs || CLOCK_SLOW_DIV == clock_div)
+        return;
+#ifdef LIB_UART_RX_H
+    if(uart_rx_available())
+        return;
+#endif
+    clock_set(CLOCK_SLOW_DIV);
+}
+
+//4-cycle loops of ms at the current clock
+static inline uint32_t clock_delay_loops(uint16_t ms)
+{
+    return (uint32_t)ms * (F_CPU / 4000) >> clock_div;
+}
+
+//_delay_ms() at the current clock, ms not a constant
+static inline void clock_delay_ms(uint16_t ms)
+{
+    clock_delay_loops_run(clock_delay_loops(ms));
+}
+
+#endif
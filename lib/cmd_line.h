@@ -0,0 +1,138 @@
+#ifndef LIB_CMD_LINE_H
+#define LIB_CMD_LINE_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+Line command parser: "name [arg ...]", e.g. "sf 9", "bw 7", "r 10".
+
+Bytes are fed one at a time, CR or LF ends the line, backspace removes
+the last byte. Arguments are 16-bit, decimal or 0x hex, 0..65535. A line that does
+not fit the buffer, has too many arguments or a bad number is rejected
+as a whole.
+
+Options, define before including:
+    CMD_LINE_LEN      - line buffer, default 8 on parts with 128 bytes of
+                        SRAM (ATtiny2313), 24 otherwise
+    CMD_LINE_ARGS_MAX - default 2
+*/
+
+#ifndef CMD_LINE_LEN
+#if defined(RAMEND) && RAMEND < 0x100
+#define CMD_LINE_LEN        8
+#else
+#define CMD_LINE_LEN        24
+#endif
+#endif
+
+#ifndef CMD_LINE_ARGS_MAX
+#define CMD_LINE_ARGS_MAX   2
+#endif
+
+//cmd_line_feed() results
+#define CMD_LINE_NONE       0
+#define CMD_LINE_READY      1
+#define CMD_LINE_ERROR      2
+
+struct CMD_LINE {
+    char buff[CMD_LINE_LEN];    //command name after CMD_LINE_READY
+    uint8_t len;                //0xFF - line too long, skip to its end
+    uint8_t argc;
+    uint16_t argv[CMD_LINE_ARGS_MAX];
+};
+
+static inline uint8_t cmd_line_digit(char ch, uint8_t base)
+{
+    if(ch >= '0' && ch <= '9')
+        return ch - '0';
+    ch |= 0x20;
+    if(16 == base && ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    return 0xFF;
+}
+
+//splits cl->buff into the name and the arguments
+static inline uint8_t cmd_line_parse(struct CMD_LINE* cl)
+{
+    char* pp = cl->buff;
+    cl->argc = 0;
+    while(*pp && ' ' != *pp)
+        pp ++;
+    while(*pp) {
+        *pp++ = 0;
+        if(!*pp || ' ' == *pp)
+            continue;
+        if(CMD_LINE_ARGS_MAX == cl->argc)
+            return CMD_LINE_ERROR;
+        uint8_t base = 10;
+        if('0' == pp[0] && 'x' == (pp[1] | 0x20)) {
+            base = 16;
+            pp += 2;
+        }
+        uint16_t val = 0;
+        uint8_t digits = 0;
+        for(; *pp && ' ' != *pp; pp ++, digits ++) {
+            uint8_t digit = cmd_line_digit(*pp, base);
+            //not a digit, or over 0xFFFF
+            if(digit >= base || val > (0xFFFF - digit) / base)
+                return CMD_LINE_ERROR;
+            val = val * base + digit;
+        }
+        if(!digits)
+            return CMD_LINE_ERROR;
+        cl->argv[cl->argc ++] = val;
+    }
+    return CMD_LINE_READY;
+}
+
+static inline uint8_t cmd_line_feed(struct CMD_LINE* cl, uint8_t ch)
+{
+    if('\r' == ch || '\n' == ch) {
+        uint8_t len = cl->len;
+        cl->len = 0;
+        if(0xFF == len)
+            return CMD_LINE_ERROR;
+        //the LF of a CRLF pair
+        if(!len && '\n' == ch)
+            return CMD_LINE_NONE;
+        cl->buff[len] = 0;
+        return cmd_line_parse(cl);
+    }
+    if(0xFF == cl->len)
+        return CMD_LINE_NONE;
+    if('\b' == ch || 0x7F == ch) {
+        if(cl->len)
+            cl->len --;
+        return CMD_LINE_NONE;
+    }
+    if(cl->len == CMD_LINE_LEN - 1) {
+        cl->len = 0xFF;
+        return CMD_LINE_NONE;
+    }
+    cl->buff[cl->len ++] = ch;
+    return CMD_LINE_NONE;
+}
+
+static inline uint8_t cmd_line_is(const struct CMD_LINE* cl, const char* name)
+{
+    const char* pp = cl->buff;
+    while(*pp && *pp == *name) {
+        pp ++;
+        name ++;
+    }
+    return *pp == *name;
+}
+
+//name in flash, e.g. cmd_line_is_P(cl, PSTR("sf"))
+static inline uint8_t cmd_line_is_P(const struct CMD_LINE* cl, PGM_P name)
+{
+    const char* pp = cl->buff;
+    while(*pp && *pp == (char)pgm_read_byte(name)) {
+        pp ++;
+        name ++;
+    }
+    return *pp == (char)pgm_read_byte(name);
+}
+
+#endif
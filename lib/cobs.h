@@ -0,0 +1,101 @@
+#ifndef LIB_COBS_H
+#define LIB_COBS_H
+
+#include <stdint.h>
+
+/*
+Binary records in COBS frames with a CRC-16, shared by the firmware and
+the host (client.c).
+
+    0x00, COBS(data[len], crc >> 8, crc & 0xFF), 0x00
+
+COBS removes every 0x00 from the record, so 0x00 only marks frame edges
+and the decoder resyncs on the next one after a lost byte. The leading
+0x00 lets the host tell a frame from a text line.
+
+data is "func inst fields...", the same func numbers as the "$ func"
+text lines, fields little-endian. Frame only funcs: TRACE_FUNC
+(lib/trace_ids.h) and RADIO_FUNC.
+
+CRC-16/CCITT-FALSE: polynomial 0x1021, init 0xFFFF, "123456789" -> 0x29B1.
+*/
+
+//LoRa packet received (test07, test09): payload[n] RegPktRssiValue
+//RegPktSnrValue RTC ticks (LE32)
+#define RADIO_FUNC          0x04
+
+//records up to 250 bytes keep the frame within 255 bytes and one COBS block
+#define COBS_DATA_MAX       250
+#define COBS_FRAME_LEN(len) ((len) + 5)
+
+static inline uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    uint8_t x = (crc >> 8) ^ data;
+    x ^= x >> 4;
+    return (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+}
+
+static inline uint16_t crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while(len --)
+        crc = crc16_update(crc, *data++);
+    return crc;
+}
+
+struct COBS_ENC {
+    uint8_t* code;  //length byte of the current block
+    uint8_t* pp;
+};
+
+static inline void cobs_put(struct COBS_ENC* enc, uint8_t data)
+{
+    if(data) {
+        *enc->pp++ = data;
+        return;
+    }
+    *enc->code = enc->pp - enc->code;
+    enc->code = enc->pp++;
+}
+
+//out - COBS_FRAME_LEN(len) bytes, len up to COBS_DATA_MAX; returns the frame length
+static inline uint8_t cobs_frame(uint8_t* out, const uint8_t* data, uint8_t len)
+{
+    struct COBS_ENC enc = {out + 1, out + 2};
+    uint16_t crc = crc16(data, len);
+    out[0] = 0;
+    while(len --)
+        cobs_put(&enc, *data++);
+    cobs_put(&enc, crc >> 8);
+    cobs_put(&enc, crc);
+    *enc.code = enc.pp - enc.code;
+    *enc.pp++ = 0;
+    return enc.pp - out;
+}
+
+//in - frame without the 0x00 edges, out - len bytes
+//returns the record length without the CRC, -1 if broken
+static inline int16_t cobs_unframe(uint8_t* out, const uint8_t* in, uint16_t len)
+{
+    uint16_t out_len = 0;
+    while(len) {
+        uint8_t code = *in++;
+        len --;
+        if(!code || code - 1 > len)
+            return -1;
+        len -= code - 1;
+        for(uint8_t i = 1; i < code; i ++) {
+            if(!*in)
+                return -1;
+            out[out_len ++] = *in++;
+        }
+        //a full block (0xFF) is not followed by a zero
+        if(len && 0xFF != code)
+            out[out_len ++] = 0;
+    }
+    if(out_len < 2 || crc16(out, out_len - 2) != (out[out_len - 2] << 8 | out[out_len - 1]))
+        return -1;
+    return out_len - 2;
+}
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef LIB_EVENT_H
+#define LIB_EVENT_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "power.h"
+
+/*
+Event bits for the main loops: ISRs post, the loop sleeps until one of
+the events it waits for is pending and runs only the matching handlers.
+
+    enum { EV_RTC, EV_LORA, EV_UART };
+
+    ISR(TIMER2_OVF_vect)
+    {
+        event_post(EV_RTC);
+    }
+
+    while(!run) {
+        uint8_t ev = event_wait(EVENT_MASK(EV_RTC) | EVENT_MASK(EV_UART));
+        if(ev & EVENT_MASK(EV_RTC))
+            f_rtc();
+        if(ev & EVENT_MASK(EV_UART))
+            f_uart(&run);
+    }
+
+The bits live in GPIOR0, an I/O register within sbi/cbi reach: posting
+is one sbi, atomic without cli. Events the loop does not wait for stay
+pending for a later loop; interrupts that post nothing (UART TX, Timer1)
+put the CPU back to sleep without running a handler. The sleep is
+power_sleep() of lib/power.h: the firmware's mode, or the deepest one
+the peripherals allow with POWER_GOVERNOR.
+
+lib/uart_rx.h posts UART_RX_EVENT for every received byte when defined.
+
+Options, define before including:
+    EVENT_STATS - count sleeps in event_sleeps, to compare wakeups and
+                  handler runs against a polling loop
+*/
+
+#define EVENT_REG       GPIOR0
+#define EVENT_MASK(ev)  (1 << (ev))
+
+#ifdef EVENT_STATS
+static volatile uint16_t event_sleeps = 0;
+#define EVENT_STAT_SLEEP() (event_sleeps ++)
+#else
+#define EVENT_STAT_SLEEP()
+#endif
+
+//ev - bit number, a constant: one sbi, from ISRs or the main loop
+static inline void event_post(uint8_t ev)
+{
+    EVENT_REG |= EVENT_MASK(ev);
+}
+
+static inline void event_clear(uint8_t mask)
+{
+    uint8_t sreg = SREG;
+    cli();
+    EVENT_REG &= ~mask;
+    SREG = sreg;
+}
+
+//sleeps until an event of mask is pending; returns and clears the pending ones of mask
+static inline uint8_t event_wait(uint8_t mask)
+{
+    uint8_t ev;
+    cli();
+    while(!(ev = EVENT_REG & mask)) {
+        EVENT_STAT_SLEEP();
+        //sleep runs before any ISR pending at sei(), no post is missed
+        power_sleep();
+        cli();
+    }
+    EVENT_REG &= ~ev;
+    sei();
+    return ev;
+}
+
+#endif
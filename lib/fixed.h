@@ -0,0 +1,167 @@
+#ifndef LIB_FIXED_H
+#define LIB_FIXED_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+Fixed-point math in place of float, the AVR has no FPU: every float
+operation is a libgcc call of 100-500 cycles and the first one links
+about 1 KB of flash.
+
+    Q8.8   int16_t, 1/256 steps,   -128 .. 127.996
+    Q16.16 int32_t, 1/65536 steps, -32768 .. 32767.99998
+
+    int32_t f = Q16_16(0.0099);         //constant, folded by the compiler
+    c -= q16_mul(s, f);
+    OCR0A = q16_int(s) + 120;
+    int32_t s = q16_sin(Q_DEG(30));     //0.5
+
+Constants are float expressions the compiler folds, no float code is
+linked unless a non-constant is converted. Angles are binary: 0x10000 per
+turn, so they wrap like the hardware counters.
+
+Error against the exact result of the same fixed-point inputs (host-10
+checks these bounds against double):
+    q8_mul, q16_mul     rounded, <= 0.5 step
+    q8_div, q16_div     truncated toward zero, < 1 step
+    q8_recip, q16_recip as the div
+    q16_sin, q16_cos    <= 1e-4 (7 steps): 64 segment quarter table,
+                        linear interpolation
+    q8_sin, q8_cos      <= 0.5 step after the Q16.16 error
+
+Products and quotients outside the range wrap (mul) or saturate (div,
+division by 0 too). q16_div is a 32-bit division plus 16 shift steps,
+not cheaper than a float division: prefer q16_mul by a constant
+reciprocal where the divisor is known. Cycle counts on the ATmega328P: "make 12_fixed_bench",
+menu "Fixed bench".
+*/
+
+#define Q8_ONE          256
+#define Q16_ONE         65536L
+
+#define Q8_8(x)         ((int16_t)((x) * 256.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q16_16(x)       ((int32_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+#define Q_DEG(deg)      ((uint16_t)((int32_t)((deg) * 65536.0 / 360 + 0.5)))
+
+//integer part, rounded down
+static inline int8_t q8_int(int16_t a)
+{
+    return a >> 8;
+}
+
+static inline int16_t q16_int(int32_t a)
+{
+    return a >> 16;
+}
+
+static inline int16_t q8_mul(int16_t a, int16_t b)
+{
+    return ((int32_t)a * b + 128) >> 8;
+}
+
+static inline int16_t q8_div(int16_t a, int16_t b)
+{
+    if(!b)
+        return a < 0 ? INT16_MIN : INT16_MAX;
+    int32_t q = (int32_t)a * 256 / b;
+    if(q > INT16_MAX)
+        return INT16_MAX;
+    if(q < INT16_MIN)
+        return INT16_MIN;
+    return q;
+}
+
+static inline int16_t q8_recip(int16_t a)
+{
+    return q8_div(Q8_ONE, a);
+}
+
+//four 16x16 bit products of the magnitudes, no 64-bit arithmetic
+static inline int32_t q16_mul(int32_t a, int32_t b)
+{
+    uint8_t neg = (a < 0) ^ (b < 0);
+    uint32_t ua = a < 0 ? -(uint32_t)a : (uint32_t)a;
+    uint32_t ub = b < 0 ? -(uint32_t)b : (uint32_t)b;
+    uint16_t ah = ua >> 16, al = ua;
+    uint16_t bh = ub >> 16, bl = ub;
+    uint32_t r = ((uint32_t)al * bl + 0x8000) >> 16;
+    r += (uint32_t)ah * bl;
+    r += (uint32_t)al * bh;
+    r += ((uint32_t)ah * bh) << 16;
+    return neg ? -(int32_t)r : (int32_t)r;
+}
+
+//integer part by one 32-bit division, then 16 fraction bits shifted in
+static inline int32_t q16_div(int32_t a, int32_t b)
+{
+    uint8_t neg = (a < 0) ^ (b < 0);
+    uint32_t ua = a < 0 ? -(uint32_t)a : (uint32_t)a;
+    uint32_t ub = b < 0 ? -(uint32_t)b : (uint32_t)b;
+    if(!ub || (ua / ub) >> 15)
+        return neg ? INT32_MIN : INT32_MAX;
+    uint32_t q = ua / ub;
+    uint32_t r = ua % ub;
+    for(uint8_t i = 16; i; i --) {
+        //r < ub <= 0x80000000, the shift does not overflow
+        r <<= 1;
+        q <<= 1;
+        if(r >= ub) {
+            r -= ub;
+            q |= 1;
+        }
+    }
+    return neg ? -(int32_t)q : (int32_t)q;
+}
+
+static inline int32_t q16_recip(int32_t a)
+{
+    return q16_div(Q16_ONE, a);
+}
+
+//sin of the first quarter in 64 steps, Q1.15
+static const uint16_t q_sin_table[65] PROGMEM = {
+    0, 804, 1608, 2411, 3212, 4011, 4808, 5602,
+    6393, 7180, 7962, 8740, 9512, 10279, 11039, 11793,
+    12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+    18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+    23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+    27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+    30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+    32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+    32768,
+};
+
+//angle - 0x10000 per turn
+static inline int32_t q16_sin(uint16_t angle)
+{
+    uint16_t x = angle & 0x3FFF;
+    if(angle & 0x4000)
+        x = 0x4000 - x;
+    uint8_t i = x >> 8;
+    uint16_t v = pgm_read_word(&q_sin_table[i]);
+    if(i < 64) {
+        uint16_t d = pgm_read_word(&q_sin_table[i + 1]) - v;
+        v += ((uint32_t)d * (uint8_t)x + 128) >> 8;
+    }
+    //Q1.15 to Q16.16
+    int32_t r = (int32_t)v << 1;
+    return angle & 0x8000 ? -r : r;
+}
+
+static inline int32_t q16_cos(uint16_t angle)
+{
+    return q16_sin(angle + 0x4000);
+}
+
+static inline int16_t q8_sin(uint16_t angle)
+{
+    return (q16_sin(angle) + 128) >> 8;
+}
+
+static inline int16_t q8_cos(uint16_t angle)
+{
+    return q8_sin(angle + 0x4000);
+}
+
+#endif
@@ -0,0 +1,214 @@
+#ifndef LIB_ISR_STAT_H
+#define LIB_ISR_STAT_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+
+#include "power.h"
+
+/*
+ISR run time and wakeup latency, min/max/avg per vector, in Timer1 counts.
+
+    ISR(TIMER2_OVF_vect)
+    {
+        ISR_STAT_ENTER();
+        g_rtc_tick = 1;
+        ISR_STAT_LEAVE(0);
+    }
+
+    isr_stat_sleep();       //instead of sleep_cpu()
+
+exec - ISR_STAT_ENTER to ISR_STAT_LEAVE: the body, without the register
+       pushes and pops of the prologue and epilogue (about 10-40 cycles,
+       see the listing) and the 8 cycles of the jump and reti.
+wake - ISR_STAT_ENTER of the first ISR after isr_stat_sleep() to the
+       return from sleep: the rest of that ISR and the way back to the
+       main loop. The hardware part before the ISR is 4 cycles from idle
+       plus the oscillator start-up from power-down (fuses, SUT).
+
+Timer1 stops in power-down and power-save: wake samples from those modes
+are 0, exec samples are right. isr_stat_init() starts Timer1 at F_CPU / 1
+unless the firmware already runs it, then counts are of that prescaler;
+it claims Timer1 (lib/power.h).
+At F_CPU / 1 Timer1 wraps every 65536 cycles, longer spans are garbage.
+
+Reports: isr_stat_print() (lib/isr_stat_print.h) over the UART, or
+isr_stat_save() to the EEPROM on boards without one, read back with
+"make isr_read" and "client -e isr_stat.bin". In a main loop call
+isr_stat_autosave(): it saves when the samples of a slot have doubled
+since the last save, at most 17 times per slot and boot, where a save
+each pass would wear the 100000 cycles of the EEPROM out in hours. The
+samples after the last save are lost at power-off.
+
+Everything compiles to nothing unless ISR_STAT_SLOTS is defined. The lib/
+ISRs take slots from UART_RX_ISR_STAT and UART_TX_ISR_STAT.
+
+Options, define before including:
+    ISR_STAT_SLOTS - number of instrumented vectors, slots 0..N-1
+*/
+
+struct ISR_STAT {
+    uint16_t count;     //samples stop at 65535
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+};
+
+struct ISR_STAT_SLOT {
+    struct ISR_STAT exec;
+    struct ISR_STAT wake;
+};
+
+//slot of ISRs outside of the statistics, e.g. lib/ ISRs the firmware does not list
+#define ISR_STAT_NONE   0xFF
+
+#ifdef ISR_STAT_SLOTS
+
+static struct ISR_STAT_SLOT isr_stat[ISR_STAT_SLOTS];
+//first ISR since isr_stat_sleep(), ISR_STAT_NONE - none yet
+static volatile uint8_t isr_stat_woke = ISR_STAT_NONE;
+static volatile uint16_t isr_stat_wake_ts;
+
+static inline void isr_stat_init()
+{
+    power_claim(POWER_TIMER1);
+    if(!(TCCR1B & 0b111)) {
+        TCCR1A = 0;
+        TCCR1B = (1 << CS10);
+    }
+}
+
+//Timer1 prescaler: cycles per count
+static inline uint16_t isr_stat_div()
+{
+    static const uint16_t div[] PROGMEM = {0, 1, 8, 64, 256, 1024, 0, 0};
+    return pgm_read_word(&div[TCCR1B & 0b111]);
+}
+
+static inline void isr_stat_add(struct ISR_STAT* st, uint16_t val)
+{
+    if(0xFFFF == st->count)
+        return;
+    if(!st->count || val < st->min)
+        st->min = val;
+    if(val > st->max)
+        st->max = val;
+    st->sum += val;
+    st->count ++;
+}
+
+static inline void isr_stat_leave(uint8_t slot, uint16_t t0)
+{
+    if(slot >= ISR_STAT_SLOTS)
+        return;
+    uint16_t now = TCNT1;
+    isr_stat_add(&isr_stat[slot].exec, now - t0);
+    if(ISR_STAT_NONE == isr_stat_woke) {
+        isr_stat_woke = slot;
+        isr_stat_wake_ts = t0;
+    }
+}
+
+#define ISR_STAT_ENTER()        uint16_t isr_stat_t0 = TCNT1
+#define ISR_STAT_LEAVE(slot)    isr_stat_leave(slot, isr_stat_t0)
+
+static inline void isr_stat_sleep()
+{
+    //sleep runs before any ISR pending at sei()
+    cli();
+    isr_stat_woke = ISR_STAT_NONE;
+    sei();
+    sleep_cpu();
+    uint16_t now = TCNT1;
+    uint8_t slot = isr_stat_woke;
+    if(slot < ISR_STAT_SLOTS)
+        isr_stat_add(&isr_stat[slot].wake, now - isr_stat_wake_ts);
+}
+
+//copy of one slot, the ISRs keep running
+static inline void isr_stat_get(uint8_t slot, struct ISR_STAT_SLOT* res)
+{
+    cli();
+    *res = isr_stat[slot];
+    sei();
+}
+
+static inline void isr_stat_reset()
+{
+    cli();
+    for(uint8_t i = 0; i < ISR_STAT_SLOTS; i ++)
+        isr_stat[i] = (struct ISR_STAT_SLOT){{0}, {0}};
+    sei();
+}
+
+//EEPROM image at address 0, all little-endian:
+//'I', 'S', slots, Timer1 prescaler (2), F_CPU / 1000 (2), struct ISR_STAT_SLOT[slots]
+#define ISR_STAT_EEPROM_HDR     7
+
+//only changed bytes are written, still mind the 100000 cycles per cell
+static inline void isr_stat_save()
+{
+    struct ISR_STAT_SLOT slot;
+    uint16_t div = isr_stat_div();
+    uint8_t hdr[ISR_STAT_EEPROM_HDR] = {
+        'I', 'S', ISR_STAT_SLOTS, div, div >> 8, (uint8_t)(F_CPU / 1000), (uint8_t)(F_CPU / 1000 >> 8)
+    };
+    eeprom_update_block(hdr, 0, sizeof(hdr));
+    for(uint8_t i = 0; i < ISR_STAT_SLOTS; i ++) {
+        isr_stat_get(i, &slot);
+        eeprom_update_block(&slot, (void*)(ISR_STAT_EEPROM_HDR + i * sizeof(slot)), sizeof(slot));
+    }
+}
+
+//exec samples of each slot at the last isr_stat_autosave()
+static uint16_t isr_stat_saved[ISR_STAT_SLOTS];
+
+static inline void isr_stat_autosave()
+{
+    uint8_t due = 0;
+    uint16_t count[ISR_STAT_SLOTS];
+    cli();
+    for(uint8_t i = 0; i < ISR_STAT_SLOTS; i ++)
+        count[i] = isr_stat[i].exec.count;
+    sei();
+    for(uint8_t i = 0; i < ISR_STAT_SLOTS; i ++) {
+        //doubled, or stopped at 65535 since
+        uint16_t saved = isr_stat_saved[i];
+        if(count[i] - saved > saved || (0xFFFF == count[i] && 0xFFFF != saved))
+            due = 1;
+    }
+    if(!due)
+        return;
+    isr_stat_save();
+    for(uint8_t i = 0; i < ISR_STAT_SLOTS; i ++)
+        isr_stat_saved[i] = count[i];
+}
+
+#else
+
+static inline void isr_stat_init()
+{
+}
+
+#define ISR_STAT_ENTER()
+#define ISR_STAT_LEAVE(slot)
+
+static inline void isr_stat_sleep()
+{
+    sleep_cpu();
+}
+
+static inline void isr_stat_save()
+{
+}
+
+static inline void isr_stat_autosave()
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef LIB_ISR_STAT_PRINT_H
+#define LIB_ISR_STAT_PRINT_H
+
+#include "isr_stat.h"
+#include "print.h"
+
+/*
+isr_stat report over the UART, one line per slot:
+
+    timer2   exec 1200 x 38/41/52  wake 1187 x 61/63/80  cycles x 1
+
+count x min/avg/max, in Timer1 counts of "cycles x" CPU cycles each.
+*/
+
+#ifdef ISR_STAT_SLOTS
+
+static inline void isr_stat_print_one(const struct ISR_STAT* st)
+{
+    p_u16(st->count);
+    p_str_P(PSTR(" x "));
+    p_u16(st->min);
+    p_char('/');
+    p_u16(st->count ? st->sum / st->count : 0);
+    p_char('/');
+    p_u16(st->max);
+}
+
+//name in flash
+static inline void isr_stat_print(uint8_t slot, PGM_P name)
+{
+    struct ISR_STAT_SLOT st;
+    isr_stat_get(slot, &st);
+    p_str_P(name);
+    p_str_P(PSTR("  exec "));
+    isr_stat_print_one(&st.exec);
+    p_str_P(PSTR("  wake "));
+    isr_stat_print_one(&st.wake);
+    p_str_P(PSTR("  cycles x "));
+    p_u16(isr_stat_div());
+    p_crlf();
+}
+
+#else
+
+static inline void isr_stat_print(uint8_t slot, PGM_P name)
+{
+}
+
+#endif
+
+#endif
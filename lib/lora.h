@@ -0,0 +1,112 @@
+#ifndef LIB_LORA_H
+#define LIB_LORA_H
+
+#include <avr/pgmspace.h>
+
+#include "spi.h"
+#include "print.h"
+
+/*
+SX1276/77/78 LoRa mode registers over lib/spi.h, the helpers shared by
+the transmitter and the receiver firmwares.
+
+Reset, pin mapping and the modem settings stay with each firmware, they
+differ between the boards.
+
+    lora_write_reg(0x01, 0b10001000);   //RegOpMode: LoRa, sleep
+    lora_print_reg(0x42);               //"0x42: 0x12 = 0001 0010"
+
+The FIFO is read and written in one SPI burst each, address 0x00.
+*/
+
+static inline uint8_t lora_read_reg(uint8_t reg)
+{
+    return spi_read_reg(reg);
+}
+
+static inline void lora_write_reg(uint8_t reg, uint8_t val)
+{
+    spi_write_reg(reg, val);
+}
+
+//bits outside mask replaced by val
+static inline void lora_update_reg(uint8_t reg, uint8_t mask, uint8_t val)
+{
+    lora_write_reg(reg, val | (mask & lora_read_reg(reg)));
+}
+
+static inline void lora_print_reg(uint8_t reg)
+{
+    uint8_t val = lora_read_reg(reg);
+    p_hex_digit(reg);
+    p_str_P(PSTR(": "));
+    p_hex_digit(val);
+    p_str_P(PSTR(" = "));
+    p_binary(val);
+    p_crlf();
+}
+
+//RegOpMode (0x01)
+static inline void lora_set_sleep_mode()
+{
+    lora_write_reg(0x01, 0b10001000);
+}
+
+//RegFifoAddrPtr
+static inline void lora_set_fifo_buffer_address(uint8_t address)
+{
+    lora_write_reg(0x0D, address);
+}
+
+//RegFifoRxCurrentAddr
+static inline uint8_t lora_get_rx_data_address()
+{
+    return lora_read_reg(0x10);
+}
+
+//RegIrqFlags
+static inline void lora_reset_irq()
+{
+    lora_write_reg(0x12, 0xff);
+}
+
+//RegRxNbBytes
+static inline uint8_t lora_get_rx_data_len()
+{
+    return lora_read_reg(0x13);
+}
+
+//RegPktSnrValue
+static inline int8_t lora_get_pkt_snr()
+{
+    return lora_read_reg(0x19);
+}
+
+//RegPktRssiValue
+static inline uint8_t lora_get_pkt_rssi()
+{
+    return lora_read_reg(0x1A);
+}
+
+//last received packet, from RegFifoRxCurrentAddr
+static inline void lora_read_fifo(uint8_t* buff, uint8_t len)
+{
+    lora_set_fifo_buffer_address(lora_get_rx_data_address());
+    spi_chip_enable();
+    spi_transfer(0);
+    while(len--)
+        *buff++ = spi_transfer(0);
+    spi_chip_disable();
+}
+
+//at RegFifoAddrPtr
+static inline void lora_write_fifo(const uint8_t* data, uint8_t len)
+{
+    spi_chip_enable();
+    spi_transfer(0x80);
+    while(len--)
+        spi_transfer(*data++);
+    spi_chip_disable();
+}
+
+#endif
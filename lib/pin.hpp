@@ -0,0 +1,80 @@
+#ifndef LIB_PIN_HPP
+#define LIB_PIN_HPP
+
+#include <stdint.h>
+#include <avr/io.h>
+
+/*
+GPIO pins as types for the C++ firmwares (avr-g++ -std=c++17 -Os): the
+port and the mask are template arguments, nothing is left for run time.
+
+    using LoraRst = Pin<PortB, 0>;
+    using Led     = Pin<PortC, 0>;
+
+    LoraRst::output();                  //sbi DDRB, 0
+    Led::high();                        //sbi PORTC, 0
+    if(Pin<PortB, 1>::read())           //sbic PINB, 1
+    Pins<PortB, 0, 2, 3, 5>::set_ddr(); //ldi + out DDRB, same as DDRB = 0b101101
+
+A single pin compiles to one sbi/cbi/sbic/sbis, a group to the same
+ldi/in/ori/andi/out sequence as the hand-written mask; "make pin_check"
+compares the disassembly of pin_check.cpp against pin_check.c.
+
+toggle() writes the mask to PINx, which flips only the pins with a 1
+(ATmega328P, ATtiny2313, not the older AVR cores).
+
+Drivers take the pins they use as template arguments instead of fixed
+masks, see lib/spi_dev.hpp.
+*/
+
+#define PIN_PORT(name, x) \
+struct name { \
+    static volatile uint8_t& pin() { return PIN##x; } \
+    static volatile uint8_t& ddr() { return DDR##x; } \
+    static volatile uint8_t& port() { return PORT##x; } \
+}
+
+#ifdef PORTA
+PIN_PORT(PortA, A);
+#endif
+#ifdef PORTB
+PIN_PORT(PortB, B);
+#endif
+#ifdef PORTC
+PIN_PORT(PortC, C);
+#endif
+#ifdef PORTD
+PIN_PORT(PortD, D);
+#endif
+
+//pins of one port, set and cleared together
+template<class PORT, uint8_t... BITS>
+struct Pins {
+    static_assert(((BITS < 8) && ...), "pin number 0..7");
+    static constexpr uint8_t mask = (0 | ... | (1 << BITS));
+
+    static void output() { PORT::ddr() |= mask; }
+    static void input() { PORT::ddr() &= (uint8_t)~mask; }
+    //DDR = mask: these pins outputs, the rest of the port inputs
+    static void set_ddr() { PORT::ddr() = mask; }
+    static void high() { PORT::port() |= mask; }
+    static void low() { PORT::port() &= (uint8_t)~mask; }
+    //PORT = mask: these pins high, the rest low or without pull-up
+    static void set_port() { PORT::port() = mask; }
+    static void toggle() { PORT::pin() = mask; }
+    //pin state as the mask bits, 0 - all low
+    static uint8_t read() { return PORT::pin() & mask; }
+};
+
+template<class PORT, uint8_t BIT>
+struct Pin : Pins<PORT, BIT> {
+    //input with the internal pull-up
+    static void pullup()
+    {
+        Pins<PORT, BIT>::input();
+        Pins<PORT, BIT>::high();
+    }
+    static bool is_high() { return Pins<PORT, BIT>::read(); }
+};
+
+#endif
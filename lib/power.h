@@ -0,0 +1,221 @@
+#ifndef LIB_POWER_H
+#define LIB_POWER_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+/*
+Peripheral clocks gated with the Power Reduction Register: drivers claim
+the peripherals they use, PRR stops the clock of every one nobody holds.
+
+    power_init();                   //first in sys_init(): all gated
+    uart_init(1);                   //lib/ drivers claim in their init
+    spi_init();
+    power_claim(POWER_TIMER2);      //the firmware's own RTC
+
+    power_claim(POWER_ADC);         //around a measurement
+    ...
+    ADCSRA = 0;
+    power_release(POWER_ADC);
+
+Claims are counted, a peripheral stops at the last release: a driver
+and a benchmark can share Timer1. Without power_init() PRR stays 0 as
+after reset until a release, the claims of the drivers change nothing.
+
+A gated peripheral keeps its state, but its registers cannot be read or
+written: claim before the first register access, release after the
+last. The datasheet wants the ADC off (ADEN clear) before its release.
+The gate stops the clock only, a peripheral that owns pins (USART TX,
+SPI, PWM) leaves them as they were.
+
+Power-down and power-save stop these clocks anyway, the gain is in
+active and idle mode, where the firmwares spend the RTC ticks and the
+UART and SPI waits. The ATmega328P datasheet lists the current of each
+module in "Supply Current of I/O modules".
+
+Sleep governor: power_sleep_mode() picks the deepest mode the running
+peripherals allow, from the registers at the moment of the sleep:
+
+    idle         the I/O clock is needed: USART receiver on or a byte
+                 still going out, SPI or TWI transfer of lib/spi_async.h
+                 or lib/twi_async.h (SPIE, TWIE), Timer0 or Timer1 or a
+                 synchronous Timer2 counting, INT0/INT1 on an edge
+    ADC noise    an ADC conversion running
+    power-save   Timer2 counting on the 32 kHz crystal (AS2)
+    power-down   nothing but the WDT, pin change and INT level wakeups
+
+Gated peripherals (PRR) are skipped. A USART that has sent nothing
+since reset counts as sending: its TXC flag is still clear.
+
+    cli();
+    while(!g_rtc_tick) {
+        power_sleep();          //sei() and sleep, in the governor's mode
+        cli();
+    }
+    sei();
+
+power_sleep() is called with interrupts off and returns with them on,
+like the "sei(); sleep_cpu();" pair it replaces; lib/event.h and
+lib/soft_timer.h sleep through it. Without POWER_GOVERNOR it sleeps in
+the firmware's mode, as before.
+
+Wakeup (datasheet, "System Clock and Clock Options"): idle and ADC
+noise reduction 4 cycles of halt, the clock keeps running; power-down
+and power-save 4 cycles plus the start-up time of the CKSEL/SUT fuses:
+6 CK on the internal RC oscillators, 258 CK to 16K CK on a crystal.
+Standby and extended standby keep the crystal running for a 6 CK start,
+at the cost of its current: POWER_STANDBY, crystal boards only. Sleep
+currents: test12 menu "Sleep modes", with a meter.
+
+After a Timer2 wakeup the asynchronous interrupt logic needs one 32 kHz
+cycle before power-save: power_sleep() rewrites TCCR2A and waits for
+its busy flag, up to 2 cycles (61 us).
+
+Only the ATmega328P PRR is handled; on the ATtiny2313 (no PRR) and the
+ATtiny13 the calls compile to nothing, power_sleep() is sei() and
+sleep_cpu().
+
+Options, define before including:
+    POWER_GOVERNOR - power_sleep() sets the mode of power_sleep_mode()
+    POWER_STANDBY  - standby in place of power-down, extended standby in
+                     place of power-save
+*/
+
+#if defined(PRR) && defined(PRUSART0)
+
+#define POWER_ADC       PRADC
+#define POWER_USART0    PRUSART0
+#define POWER_SPI       PRSPI
+#define POWER_TIMER1    PRTIM1
+#define POWER_TIMER0    PRTIM0
+#define POWER_TIMER2    PRTIM2
+#define POWER_TWI       PRTWI
+
+#define POWER_ALL       ((1 << PRADC) | (1 << PRUSART0) | (1 << PRSPI) | (1 << PRTIM1) \
+                        | (1 << PRTIM0) | (1 << PRTIM2) | (1 << PRTWI))
+
+//claims per PRR bit
+static uint8_t power_refs[8];
+
+//gates every peripheral without a claim
+static inline void power_init()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t prr = POWER_ALL;
+    for(uint8_t i = 0; i < 8; i ++) {
+        if(power_refs[i])
+            prr &= ~(1 << i);
+    }
+    PRR = prr;
+    SREG = sreg;
+}
+
+//p - POWER_x, a constant
+static inline void power_claim(uint8_t p)
+{
+    uint8_t sreg = SREG;
+    cli();
+    if(!power_refs[p] ++)
+        PRR &= ~(1 << p);
+    SREG = sreg;
+}
+
+//a release without a claim is ignored
+static inline void power_release(uint8_t p)
+{
+    uint8_t sreg = SREG;
+    cli();
+    if(power_refs[p] && !-- power_refs[p])
+        PRR |= 1 << p;
+    SREG = sreg;
+}
+
+#ifdef POWER_STANDBY
+#define POWER_SLEEP_DOWN    SLEEP_MODE_STANDBY
+#define POWER_SLEEP_SAVE    SLEEP_MODE_EXT_STANDBY
+#else
+#define POWER_SLEEP_DOWN    SLEEP_MODE_PWR_DOWN
+#define POWER_SLEEP_SAVE    SLEEP_MODE_PWR_SAVE
+#endif
+
+//clocked and not gated
+#define POWER_ON(p, prr)    (!((prr) & (1 << (p))))
+
+static inline uint8_t power_sleep_mode()
+{
+    uint8_t prr = PRR;
+    if(POWER_ON(PRUSART0, prr)) {
+        uint8_t b = UCSR0B;
+        if(b & ((1 << RXEN0) | (1 << UDRIE0)))
+            return SLEEP_MODE_IDLE;
+        if(b & (1 << TXEN0) && !(UCSR0A & (1 << TXC0)))
+            return SLEEP_MODE_IDLE;
+    }
+    if(POWER_ON(PRSPI, prr) && SPCR & (1 << SPIE))
+        return SLEEP_MODE_IDLE;
+    if(POWER_ON(PRTWI, prr) && TWCR & (1 << TWIE))
+        return SLEEP_MODE_IDLE;
+    if(POWER_ON(PRTIM0, prr) && TCCR0B & 0b111)
+        return SLEEP_MODE_IDLE;
+    if(POWER_ON(PRTIM1, prr) && TCCR1B & 0b111)
+        return SLEEP_MODE_IDLE;
+    uint8_t rtc = POWER_ON(PRTIM2, prr) && TCCR2B & 0b111;
+    if(rtc && !(ASSR & (1 << AS2)))
+        return SLEEP_MODE_IDLE;
+    //INT0 and INT1 wake from power-down on the low level only
+    if((EIMSK & (1 << INT0) && EICRA & 0b0011) || (EIMSK & (1 << INT1) && EICRA & 0b1100))
+        return SLEEP_MODE_IDLE;
+    if(POWER_ON(PRADC, prr) && ADCSRA & (1 << ADSC))
+        return SLEEP_MODE_ADC;
+    return rtc ? POWER_SLEEP_SAVE : POWER_SLEEP_DOWN;
+}
+
+//interrupts off on entry, on at return
+static inline void power_sleep()
+{
+#ifdef POWER_GOVERNOR
+    uint8_t mode = power_sleep_mode();
+    if(POWER_SLEEP_SAVE == mode || (SLEEP_MODE_ADC == mode && ASSR & (1 << AS2))) {
+        //the Timer2 interrupt logic resets one TOSC1 cycle after a wakeup
+        TCCR2A = TCCR2A;
+        while(ASSR & (1 << TCR2AUB));
+    }
+    set_sleep_mode(mode);
+#endif
+    sei();
+    sleep_cpu();
+}
+
+#else
+
+#define POWER_ADC       0
+#define POWER_USART0    0
+#define POWER_SPI       0
+#define POWER_TIMER1    0
+#define POWER_TIMER0    0
+#define POWER_TIMER2    0
+#define POWER_TWI       0
+
+static inline void power_init()
+{
+}
+
+static inline void power_claim(uint8_t p)
+{
+}
+
+static inline void power_release(uint8_t p)
+{
+}
+
+static inline void power_sleep()
+{
+    sei();
+    sleep_cpu();
+}
+
+#endif
+
+#endif
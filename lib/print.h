@@ -0,0 +1,180 @@
+#ifndef LIB_PRINT_H
+#define LIB_PRINT_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#include "uart_tx.h"
+
+/*
+Typed console output straight to uart_tx(), in place of fprintf().
+
+vfprintf parses the format at run time and pulls the whole formatter in
+(about 1.5 KB of flash for the integer-only version). These calls only
+link what is used; u16 and hex avoid 32-bit division entirely.
+
+    p_u16(1234)         1234        p_hex8(0x0a)        0a
+    p_i16(-5)           -5          p_hex16(0x1d)       001d
+    p_u32(70000)        70000       p_hex(0x1a2b3, 5)   1a2b3
+    p_i32(-70000)       -70000      p_fixed(-1505, 2)   -15.05
+    p_hex_digit(0x5c)   0x5C        p_binary(0x5c)      0101 1100
+
+String literals are copied to SRAM at startup unless they are placed in
+flash: use p_str_P(PSTR("...")) and p_line_P(PSTR("...")) for constant
+text, or a PROGMEM array when the same text is printed from several places.
+*/
+
+static inline void p_char(char ch)
+{
+    uart_tx(ch);
+}
+
+static inline void p_str(const char* str)
+{
+    while(*str)
+        uart_tx(*str++);
+}
+
+static inline void p_crlf()
+{
+    uart_tx('\r');
+    uart_tx('\n');
+}
+
+static inline void p_line(const char* str)
+{
+    p_str(str);
+    p_crlf();
+}
+
+//str in flash, PSTR() or PROGMEM
+static inline void p_str_P(PGM_P str)
+{
+    char ch;
+    while((ch = pgm_read_byte(str++)))
+        uart_tx(ch);
+}
+
+static inline void p_line_P(PGM_P str)
+{
+    p_str_P(str);
+    p_crlf();
+}
+
+//digits - number of nibbles printed, from the lowest one
+static inline void p_hex(uint32_t val, uint8_t digits)
+{
+    static const char hex_chars[] PROGMEM = "0123456789abcdef";
+    while(digits --)
+        uart_tx(pgm_read_byte(&hex_chars[(val >> (digits << 2)) & 0x0F]));
+}
+
+static inline void p_hex8(uint8_t val)
+{
+    p_hex(val, 2);
+}
+
+static inline void p_hex16(uint16_t val)
+{
+    p_hex(val, 4);
+}
+
+//register dumps: "0x" and two upper case digits
+static inline void p_hex_digit(uint8_t val)
+{
+    p_str_P(PSTR("0x"));
+    for(uint8_t i = 0; i < 2; i ++, val <<= 4) {
+        uint8_t nibble = val >> 4;
+        uart_tx(nibble < 10 ? '0' + nibble : 'A' - 10 + nibble);
+    }
+}
+
+//two nibbles, "0101 1100"
+static inline void p_binary(uint8_t val)
+{
+    uint8_t i = 0b10000000;
+    while(i > 0b00001000) {
+        uart_tx(val & i ? '1' : '0');
+        i >>= 1;
+    }
+    uart_tx(' ');
+    while(i) {
+        uart_tx(val & i ? '1' : '0');
+        i >>= 1;
+    }
+}
+
+static inline void p_u16(uint16_t val)
+{
+    char buff[5];
+    uint8_t len = 0;
+    do {
+        buff[len ++] = '0' + val % 10;
+        val /= 10;
+    } while(val);
+    while(len)
+        uart_tx(buff[-- len]);
+}
+
+static inline void p_u32(uint32_t val)
+{
+    char buff[10];
+    uint8_t len = 0;
+    //32-bit division only while the value does not fit 16 bits
+    while(val > 0xFFFF) {
+        buff[len ++] = '0' + val % 10;
+        val /= 10;
+    }
+    uint16_t low = val;
+    do {
+        buff[len ++] = '0' + low % 10;
+        low /= 10;
+    } while(low);
+    while(len)
+        uart_tx(buff[-- len]);
+}
+
+static inline void p_i16(int16_t val)
+{
+    if(val < 0) {
+        uart_tx('-');
+        p_u16(-(uint16_t)val);
+        return;
+    }
+    p_u16(val);
+}
+
+static inline void p_i32(int32_t val)
+{
+    if(val < 0) {
+        uart_tx('-');
+        p_u32(-(uint32_t)val);
+        return;
+    }
+    p_u32(val);
+}
+
+//val in units of 10^-frac, e.g. p_fixed(3300, 3) prints 3.300
+static inline void p_fixed(int32_t val, uint8_t frac)
+{
+    uint32_t mag = val;
+    uint32_t div = 1;
+    if(val < 0) {
+        uart_tx('-');
+        mag = -mag;
+    }
+    for(uint8_t i = frac; i; i --)
+        div *= 10;
+    p_u32(mag / div);
+    if(!frac)
+        return;
+    uart_tx('.');
+    mag %= div;
+    while(frac --) {
+        div /= 10;
+        uart_tx('0' + mag / div);
+        mag %= div;
+    }
+}
+
+#endif
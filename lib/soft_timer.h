@@ -0,0 +1,169 @@
+#ifndef LIB_SOFT_TIMER_H
+#define LIB_SOFT_TIMER_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "power.h"
+
+/*
+Software timers on the watchdog interrupt, for the long waits that kept
+the CPU running in _delay_ms(): the CPU sleeps between the WDT ticks,
+in power-down if the firmware sets that sleep mode (or POWER_GOVERNOR of
+lib/power.h finds nothing else running).
+
+    static void f_measure() { ... }
+
+    timer_init();
+    timer_start(0, TIMER_MS(1000), TIMER_MS(1000), f_measure);  //periodic
+    timer_start(1, TIMER_MS(500), 0, led_off);                   //one-shot
+    while(1)
+        timer_wait();       //sleeps, then runs the callbacks due
+
+    timer_sleep(TIMER_MS(2000));    //blocking, in place of _delay_ms(2000)
+
+Callbacks run in the main loop (timer_run(), timer_wait()), not in the
+ISR: they may print and use SPI or TWI. timer_sleep() runs none of them,
+the ones due meanwhile run at the next timer_run().
+
+The WDT runs on its own 128 kHz oscillator on every board, no crystal
+needed (Timer2 async would want the 32 kHz one), but it is only about
++-10% accurate, like the internal RC the _delay_ms() waits counted on.
+A wait ends within one tick: the first tick comes whenever the WDT
+counter wraps. Power-down stops the UART clock, call uart_tx_flush()
+first (lib/uart_tx.h).
+
+The WDT is in interrupt mode, a firmware using it as a reset watchdog
+cannot have these timers.
+
+Options, define before including:
+    TIMER_COUNT - timers 0..N-1, up to 8, default 2
+    TIMER_WDP   - tick = 16 ms << TIMER_WDP, 0 (default) to 9
+    TIMER_EVENT - lib/event.h event posted when a timer is due
+*/
+
+#ifndef TIMER_COUNT
+#define TIMER_COUNT     2
+#endif
+
+#if TIMER_COUNT > 8
+#error "TIMER_COUNT up to 8"
+#endif
+
+#ifndef TIMER_WDP
+#define TIMER_WDP       0
+#endif
+
+#if TIMER_WDP > 9
+#error "TIMER_WDP 0..9"
+#endif
+
+#ifdef TIMER_EVENT
+#include "event.h"
+#endif
+
+#define TIMER_TICK_MS   (16UL << TIMER_WDP)
+//ticks of a constant wait, rounded to the nearest
+#define TIMER_MS(ms)    ((uint16_t)(((ms) + TIMER_TICK_MS / 2) / TIMER_TICK_MS))
+
+#ifdef UDR0
+#define TIMER_WDT_vect  WDT_vect
+#else
+#define TIMER_WDT_vect  WDT_OVERFLOW_vect
+#endif
+
+struct SOFT_TIMER {
+    uint16_t left;      //ticks to the next callback, 0 - stopped
+    uint16_t period;    //0 - one-shot
+    void (*cb)();
+};
+
+static struct SOFT_TIMER timer_arr[TIMER_COUNT];
+static volatile uint8_t timer_due = 0;
+static volatile uint16_t timer_sleep_left = 0;
+
+ISR(TIMER_WDT_vect)
+{
+    for(uint8_t i = 0; i < TIMER_COUNT; i ++) {
+        struct SOFT_TIMER* t = &timer_arr[i];
+        if(!t->left || --t->left)
+            continue;
+        t->left = t->period;
+        timer_due |= 1 << i;
+#ifdef TIMER_EVENT
+        event_post(TIMER_EVENT);
+#endif
+    }
+    if(timer_sleep_left)
+        timer_sleep_left --;
+}
+
+static inline void timer_init()
+{
+    uint8_t sreg = SREG;
+    cli();
+    WDTCSR = (1 << WDCE) | (1 << WDE);
+    WDTCSR = (1 << WDIE) | ((TIMER_WDP & 8) ? (1 << WDP3) : 0) | (TIMER_WDP & 7);
+    SREG = sreg;
+}
+
+//ticks - first callback, period - then every period ticks, 0 - once
+static inline void timer_start(uint8_t id, uint16_t ticks, uint16_t period, void (*cb)())
+{
+    struct SOFT_TIMER* t = &timer_arr[id];
+    uint8_t sreg = SREG;
+    cli();
+    t->cb = cb;
+    t->period = period;
+    t->left = ticks ? ticks : 1;
+    timer_due &= ~(1 << id);
+    SREG = sreg;
+}
+
+static inline void timer_stop(uint8_t id)
+{
+    uint8_t sreg = SREG;
+    cli();
+    timer_arr[id].left = 0;
+    timer_due &= ~(1 << id);
+    SREG = sreg;
+}
+
+//runs the callbacks due, in timer order
+static inline void timer_run()
+{
+    cli();
+    uint8_t due = timer_due;
+    timer_due = 0;
+    sei();
+    for(uint8_t i = 0; due; i ++, due >>= 1) {
+        if(due & 1)
+            timer_arr[i].cb();
+    }
+}
+
+//sleeps until a timer is due and runs the callbacks
+static inline void timer_wait()
+{
+    cli();
+    while(!timer_due) {
+        power_sleep();
+        cli();
+    }
+    sei();
+    timer_run();
+}
+
+static inline void timer_sleep(uint16_t ticks)
+{
+    cli();
+    timer_sleep_left = ticks;
+    while(timer_sleep_left) {
+        power_sleep();
+        cli();
+    }
+    sei();
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef LIB_SPI_H
+#define LIB_SPI_H
+
+#include <avr/io.h>
+
+#include "power.h"
+
+/*
+Polled SPI master on the ATmega328P pins, one device with its chip
+select on SS (PB2): the SX1276 LoRa module, the Si4432 boards and the
+Nokia 5110 LCD.
+
+    spi_init();
+    uint8_t ver = spi_read_reg(0x42);
+    spi_write_reg(0x01, 0x88);
+
+Register access is the common "address byte, data byte" frame, the top
+address bit set for a write (SX127x, Si443x, most SPI sensors).
+
+spi_init() only adds MOSI, SCK and SS to DDRB, other pins of the port
+keep their direction. SS must stay an output, as an input low level
+would drop the hardware back to slave mode. spi_init() claims the SPI
+(lib/power.h).
+
+Options, define before including:
+    SPI_CLOCK_DIV - SCK = F_CPU / SPI_CLOCK_DIV: 2, 4 (default), 8, 16,
+                    32, 64, 128
+    SPI_STATS     - count the bytes moved in spi_transfers
+*/
+
+#ifndef SPI_CLOCK_DIV
+#define SPI_CLOCK_DIV   4
+#endif
+
+#if SPI_CLOCK_DIV == 2
+#define SPI_SPCR_CLOCK  0
+#define SPI_SPSR_CLOCK  (1 << SPI2X)
+#elif SPI_CLOCK_DIV == 4
+#define SPI_SPCR_CLOCK  0
+#define SPI_SPSR_CLOCK  0
+#elif SPI_CLOCK_DIV == 8
+#define SPI_SPCR_CLOCK  (1 << SPR0)
+#define SPI_SPSR_CLOCK  (1 << SPI2X)
+#elif SPI_CLOCK_DIV == 16
+#define SPI_SPCR_CLOCK  (1 << SPR0)
+#define SPI_SPSR_CLOCK  0
+#elif SPI_CLOCK_DIV == 32
+#define SPI_SPCR_CLOCK  (1 << SPR1)
+#define SPI_SPSR_CLOCK  (1 << SPI2X)
+#elif SPI_CLOCK_DIV == 64
+#define SPI_SPCR_CLOCK  (1 << SPR1)
+#define SPI_SPSR_CLOCK  0
+#elif SPI_CLOCK_DIV == 128
+#define SPI_SPCR_CLOCK  ((1 << SPR1) | (1 << SPR0))
+#define SPI_SPSR_CLOCK  0
+#else
+#error "SPI_CLOCK_DIV: 2, 4, 8, 16, 32, 64 or 128"
+#endif
+
+#define SPI_CS          (1 << PB2)
+
+#ifdef SPI_STATS
+static uint32_t spi_transfers = 0;
+#endif
+
+static inline void spi_chip_enable()
+{
+    PORTB &= ~SPI_CS;
+}
+
+static inline void spi_chip_disable()
+{
+    PORTB |= SPI_CS;
+}
+
+static inline void spi_init()
+{
+    power_claim(POWER_SPI);
+    DDRB |= SPI_CS | (1 << PB3) | (1 << PB5);   //SS, MOSI, SCK
+    spi_chip_disable();
+    SPSR = SPI_SPSR_CLOCK;
+    SPCR = (1 << SPE) | (1 << MSTR) | SPI_SPCR_CLOCK;
+}
+
+static inline void spi_wait_write()
+{
+    while(!(SPSR & (1 << SPIF)));
+}
+
+//one byte each way, chip select left to the caller
+static inline uint8_t spi_transfer(uint8_t data)
+{
+#ifdef SPI_STATS
+    spi_transfers ++;
+#endif
+    SPDR = data;
+    spi_wait_write();
+    return SPDR;
+}
+
+static inline uint8_t spi_read_reg(uint8_t reg)
+{
+    spi_chip_enable();
+    spi_transfer(reg);
+    uint8_t val = spi_transfer(0);
+    spi_chip_disable();
+    return val;
+}
+
+static inline void spi_write_reg(uint8_t reg, uint8_t val)
+{
+    spi_chip_enable();
+    spi_transfer(reg | 0x80);
+    spi_transfer(val);
+    spi_chip_disable();
+}
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef LIB_SPI_ASYNC_H
+#define LIB_SPI_ASYNC_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#include "spi.h"
+
+/*
+Interrupt-driven SPI master: multi-byte transfers queued per device, run
+one after another by the SPI STC interrupt, each with the chip select
+and the clock of its device.
+
+    static const struct SPI_DEV lcd = SPI_DEV_INIT(PORTB, PB2, 16);
+    static struct SPI_XFER x;
+
+    spi_init();
+    spi_xfer_write(&x, &lcd, frame, sizeof(frame), 0);
+    update(obj);                        //the frame goes out meanwhile
+    spi_wait(&x);                       //idle sleep until done
+
+A transfer is an optional command byte (register address, its reply is
+dropped) and len bytes, at least 1 without the command: sent from tx
+(0x00 if tx is 0), received into rx (dropped if rx is 0). CS goes low
+for the whole transfer.
+
+The transfer and its buffers belong to the caller and must stay in
+scope until status is SPI_DONE; the queue holds pointers only. done(),
+if set, runs in the ISR at the end: keep it short, e.g. post a
+lib/event.h event.
+
+A byte costs the ISR about 40-50 cycles, the CPU gains only when a byte
+takes longer than that: SCK of F_CPU / 16 and slower (128 cycles a
+byte). At F_CPU / 2..8 the polled calls of lib/spi.h are faster.
+
+The polled calls must wait for spi_async_idle(), they would take the
+SPIF flag of a running transfer; the queue puts the lib/spi.h clock
+back when it runs empty. spi_wait() sleeps in idle and puts the
+firmware's sleep mode back: the SPI stops in power-down and power-save.
+
+Options, define before including:
+    SPI_QUEUE_SIZE - power of two up to 128, default 4
+*/
+
+#ifndef SPI_QUEUE_SIZE
+#define SPI_QUEUE_SIZE  4
+#endif
+
+#if SPI_QUEUE_SIZE & (SPI_QUEUE_SIZE - 1) || SPI_QUEUE_SIZE > 128
+#error "SPI_QUEUE_SIZE must be a power of two up to 128"
+#endif
+
+#define SPI_QUEUE_MASK  (SPI_QUEUE_SIZE - 1)
+
+//SPCR and SPSR of a master at SCK = F_CPU / div, div a constant: 2, 4, .. 128
+#define SPI_DIV_SPCR(div) ((1 << SPE) | (1 << MSTR) | (1 << SPIE) \
+    | ((div) == 8 || (div) == 16 ? (1 << SPR0) : 0) \
+    | ((div) == 32 || (div) == 64 ? (1 << SPR1) : 0) \
+    | ((div) == 128 ? (1 << SPR1) | (1 << SPR0) : 0))
+#define SPI_DIV_SPSR(div) ((div) == 2 || (div) == 8 || (div) == 32 ? (1 << SPI2X) : 0)
+
+//port - PORTx, its DDR bit is the firmware's, pin - bit number
+#define SPI_DEV_INIT(port, pin, div) {&(port), 1 << (pin), SPI_DIV_SPCR(div), SPI_DIV_SPSR(div)}
+
+struct SPI_DEV {
+    volatile uint8_t* cs_port;
+    uint8_t cs_mask;
+    uint8_t spcr;
+    uint8_t spsr;
+};
+
+enum { SPI_QUEUED, SPI_BUSY, SPI_DONE };
+
+struct SPI_XFER {
+    const struct SPI_DEV* dev;
+    const uint8_t* tx;
+    uint8_t* rx;
+    uint16_t len;
+    uint8_t cmd;
+    uint8_t has_cmd;
+    volatile uint8_t status;
+    void (*done)(struct SPI_XFER* x);
+};
+
+static struct SPI_XFER* volatile spi_queue[SPI_QUEUE_SIZE];
+static volatile uint8_t spi_queue_head = 0;
+static volatile uint8_t spi_queue_tail = 0;
+//bytes of the current transfer sent, the command byte included
+static uint16_t spi_pos = 0;
+
+static inline uint8_t spi_async_idle()
+{
+    return spi_queue_head == spi_queue_tail;
+}
+
+static inline uint8_t spi_xfer_byte(const struct SPI_XFER* x, uint16_t i)
+{
+    return x->tx ? x->tx[i] : 0;
+}
+
+//CS low, the device clock and the first byte
+static inline void spi_async_start(struct SPI_XFER* x)
+{
+    x->status = SPI_BUSY;
+    SPSR = x->dev->spsr;
+    SPCR = x->dev->spcr;
+    *x->dev->cs_port &= ~x->dev->cs_mask;
+    spi_pos = 1;
+    SPDR = x->has_cmd ? x->cmd : spi_xfer_byte(x, 0);
+}
+
+ISR(SPI_STC_vect)
+{
+    uint8_t tail = spi_queue_tail;
+    struct SPI_XFER* x = spi_queue[tail];
+    uint8_t in = SPDR;
+    uint16_t n = x->len + x->has_cmd;
+    uint16_t i = spi_pos - x->has_cmd;
+    if(spi_pos > x->has_cmd && x->rx)
+        x->rx[i - 1] = in;
+    if(spi_pos < n) {
+        SPDR = spi_xfer_byte(x, i);
+        spi_pos ++;
+        return;
+    }
+    *x->dev->cs_port |= x->dev->cs_mask;
+    tail = (tail + 1) & SPI_QUEUE_MASK;
+    spi_queue_tail = tail;
+    if(tail != spi_queue_head)
+        spi_async_start(spi_queue[tail]);
+    else {
+        //lib/spi.h settings back for the polled calls
+        SPSR = SPI_SPSR_CLOCK;
+        SPCR = (1 << SPE) | (1 << MSTR) | SPI_SPCR_CLOCK;
+    }
+    x->status = SPI_DONE;
+    if(x->done)
+        x->done(x);
+}
+
+//returns 1 if the queue is full
+static inline uint8_t spi_submit(struct SPI_XFER* x)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t head = spi_queue_head;
+    uint8_t next = (head + 1) & SPI_QUEUE_MASK;
+    if(next == spi_queue_tail) {
+        SREG = sreg;
+        return 1;
+    }
+    x->status = SPI_QUEUED;
+    spi_queue[head] = x;
+    spi_queue_head = next;
+    if(head == spi_queue_tail)
+        spi_async_start(x);
+    SREG = sreg;
+    return 0;
+}
+
+//len bytes from tx, nothing kept
+static inline uint8_t spi_xfer_write(struct SPI_XFER* x, const struct SPI_DEV* dev,
+        const uint8_t* tx, uint16_t len, void (*done)(struct SPI_XFER* x))
+{
+    x->dev = dev;
+    x->tx = tx;
+    x->rx = 0;
+    x->len = len;
+    x->has_cmd = 0;
+    x->done = done;
+    return spi_submit(x);
+}
+
+//register burst: cmd, then len bytes into rx (0x00 sent)
+static inline uint8_t spi_xfer_read_cmd(struct SPI_XFER* x, const struct SPI_DEV* dev, uint8_t cmd,
+        uint8_t* rx, uint16_t len, void (*done)(struct SPI_XFER* x))
+{
+    x->dev = dev;
+    x->tx = 0;
+    x->rx = rx;
+    x->len = len;
+    x->cmd = cmd;
+    x->has_cmd = 1;
+    x->done = done;
+    return spi_submit(x);
+}
+
+static inline void spi_wait(struct SPI_XFER* x)
+{
+    uint8_t smcr = SMCR;
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    while(SPI_DONE != x->status) {
+        sei();
+        sleep_cpu();
+        cli();
+    }
+    SMCR = smcr;
+    sei();
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef LIB_SPI_DEV_HPP
+#define LIB_SPI_DEV_HPP
+
+#include "pin.hpp"
+
+extern "C" {
+#include "spi.h"
+}
+
+/*
+SPI device with its chip select pin as a type, over the lib/spi.h bus.
+
+    using Lora = SpiDev<Pin<PortB, 2>>;
+    using Lcd  = SpiDev<Pin<PortD, 4>>;
+
+    spi_init();
+    Lora::init();
+    uint8_t ver = Lora::read_reg(0x42);
+
+spi_init() still makes SS (PB2) an output, the SPI master needs it, so
+a device on another pin leaves PB2 free only as an output.
+*/
+
+template<class CS>
+struct SpiDev {
+    static void init()
+    {
+        CS::high();
+        CS::output();
+    }
+
+    static void select() { CS::low(); }
+    static void deselect() { CS::high(); }
+
+    static uint8_t read_reg(uint8_t reg)
+    {
+        select();
+        spi_transfer(reg);
+        uint8_t val = spi_transfer(0);
+        deselect();
+        return val;
+    }
+
+    static void write_reg(uint8_t reg, uint8_t val)
+    {
+        select();
+        spi_transfer(reg | 0x80);
+        spi_transfer(val);
+        deselect();
+    }
+};
+
+#endif
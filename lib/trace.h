@@ -0,0 +1,145 @@
+#ifndef LIB_TRACE_H
+#define LIB_TRACE_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "trace_ids.h"
+#include "cobs.h"
+#include "power.h"
+#include "uart_tx.h"
+
+/*
+Event trace in a RAM ring, for timing problems that p_line() calls hide.
+
+    trace(TRACE_RX_CHECK, PINB & LORA_RX_TX_DONE);
+
+An event is an id (lib/trace_ids.h), one byte argument and the Timer1
+count: 4 bytes and about 30 cycles, from the main loop or an ISR. When
+the ring is full the oldest event is dropped and counted. trace_dump()
+sends the events as COBS frames (func TRACE_FUNC) and empties the ring,
+"client" prints them as a timeline.
+
+Timer1 runs free at F_CPU / 256, 32 us per count at 8 MHz. It wraps
+after 65536 counts (2.1 s), the host assumes less than one wrap between
+two events. trace_init() takes Timer1 over and claims it (lib/power.h).
+
+Options, define before including:
+    TRACE_SIZE  - ring size in events, power of two up to 128, default 64
+    TRACE_OFF   - trace() and trace_dump() compile to nothing
+*/
+
+#ifndef TRACE_SIZE
+#define TRACE_SIZE  64
+#endif
+
+#if TRACE_SIZE & (TRACE_SIZE - 1) || TRACE_SIZE > 128
+#error "TRACE_SIZE must be a power of two up to 128"
+#endif
+
+#define TRACE_MASK          (TRACE_SIZE - 1)
+#define TRACE_TICK_US       (256000000UL / F_CPU)
+//events per dump frame, keeps the frame buffers on the stack small
+#define TRACE_FRAME_EVENTS  16
+
+struct TRACE_EVENT {
+    uint8_t id;
+    uint8_t arg;
+    uint16_t ts;
+};
+
+#ifdef TRACE_OFF
+
+static inline void trace_init()
+{
+}
+
+static inline void trace(uint8_t id, uint8_t arg)
+{
+}
+
+static inline void trace_dump()
+{
+}
+
+#else
+
+static struct TRACE_EVENT trace_ring[TRACE_SIZE];
+static uint8_t trace_head = 0;
+static uint8_t trace_tail = 0;
+static uint8_t trace_lost = 0;  //saturates at 255
+
+static inline void trace_init()
+{
+    power_claim(POWER_TIMER1);
+    TCCR1A = 0;
+    TCCR1B = (1 << CS12);   //F_CPU / 256, normal mode
+}
+
+static inline void trace(uint8_t id, uint8_t arg)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t head = trace_head;
+    struct TRACE_EVENT* ev = &trace_ring[head];
+    ev->ts = TCNT1;
+    ev->id = id;
+    ev->arg = arg;
+    head = (head + 1) & TRACE_MASK;
+    if(head == trace_tail) {
+        trace_tail = (head + 1) & TRACE_MASK;
+        if(trace_lost != 0xFF)
+            trace_lost ++;
+    }
+    trace_head = head;
+    SREG = sreg;
+}
+
+//takes the oldest event, 0 if empty
+static inline uint8_t trace_pop(struct TRACE_EVENT* ev)
+{
+    uint8_t res = 0;
+    cli();
+    if(trace_tail != trace_head) {
+        *ev = trace_ring[trace_tail];
+        trace_tail = (trace_tail + 1) & TRACE_MASK;
+        res = 1;
+    }
+    sei();
+    return res;
+}
+
+//frame: TRACE_FUNC, 0, part, lost, tick_us (LE16), events: id, arg, ts (LE16)
+static inline void trace_dump()
+{
+    uint8_t rec[6 + 4 * TRACE_FRAME_EVENTS];
+    uint8_t frame[COBS_FRAME_LEN(sizeof(rec))];
+    uint8_t part = 0;
+    struct TRACE_EVENT ev;
+    uint8_t more;
+    do {
+        uint8_t len = 6;
+        rec[0] = TRACE_FUNC;
+        rec[1] = 0;
+        rec[2] = part ++;
+        cli();
+        rec[3] = trace_lost;
+        trace_lost = 0;
+        sei();
+        rec[4] = TRACE_TICK_US;
+        rec[5] = TRACE_TICK_US >> 8;
+        while((more = len < sizeof(rec)) && trace_pop(&ev)) {
+            rec[len ++] = ev.id;
+            rec[len ++] = ev.arg;
+            rec[len ++] = ev.ts;
+            rec[len ++] = ev.ts >> 8;
+        }
+        uint8_t frame_len = cobs_frame(frame, rec, len);
+        for(uint8_t i = 0; i < frame_len; i ++)
+            uart_tx(frame[i]);
+    } while(!more);
+}
+
+#endif
+
+#endif
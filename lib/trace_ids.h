@@ -0,0 +1,27 @@
+#ifndef LIB_TRACE_IDS_H
+#define LIB_TRACE_IDS_H
+
+/*
+Trace event ids, shared by the firmware (lib/trace.h) and the host
+decoder (client.c). The argument of each event is up to the caller.
+*/
+
+//func number of the trace dump frames, see lib/cobs.h
+#define TRACE_FUNC  0x03
+
+enum TRACE_ID {
+    TRACE_NONE,
+    TRACE_WAKE,         //arg - low byte of the RTC ticks
+    TRACE_SLEEP,
+    TRACE_RX_CHECK,     //arg - DIO0 pin
+    TRACE_RX_DONE,
+    TRACE_RX_READ,      //arg - packet length
+    TRACE_TX,
+    TRACE_TX_DONE,
+    TRACE_CMD,          //arg - first byte of the command
+    TRACE_ID_COUNT,
+
+    TRACE_USER = 0x80   //0x80..0xFF - free for a single test
+};
+
+#endif
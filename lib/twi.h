@@ -0,0 +1,156 @@
+#ifndef LIB_TWI_H
+#define LIB_TWI_H
+
+#include <avr/io.h>
+#include <util/twi.h>
+
+#include "power.h"
+
+/*
+Polled TWI (I2C) master, register reads and writes of one transfer each.
+
+    twi_init();
+    if(i2c_read_reg(0x90, 0, buff, 2))   //8-bit address, R/W bit clear
+        ...error: no ACK or bus error
+
+i2c_read_reg() and i2c_write_reg() return 0 on success, 1 if a step was
+not acknowledged; the bus is released with a STOP either way.
+twi_init() claims the TWI (lib/power.h).
+
+Options, define before including:
+    TWI_FREQ - SCL frequency, default 400000; prescaler 1, so
+               F_CPU / 526 .. F_CPU / 16
+*/
+
+#ifndef TWI_FREQ
+#define TWI_FREQ        400000UL
+#endif
+
+#define TWI_TWBR        ((F_CPU / TWI_FREQ - 16) / 2)
+
+_Static_assert(F_CPU / TWI_FREQ >= 16 && TWI_TWBR <= 0xFF, "TWI_FREQ is not reachable from F_CPU");
+
+static inline void twi_init()
+{
+    power_claim(POWER_TWI);
+    TWSR = 0x00;
+    TWBR = TWI_TWBR;
+    TWCR = (1 << TWEN);
+}
+
+static inline void twi_wait_complete()
+{
+    while(!(TWCR & (1 << TWINT)));
+}
+
+static inline void twi_send_start()
+{
+    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
+    twi_wait_complete();
+}
+
+static inline void twi_send_stop()
+{
+    TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+}
+
+static inline void twi_write(uint8_t data)
+{
+    TWDR = data;
+    TWCR = (1 << TWINT) | (1 << TWEN);
+    twi_wait_complete();
+}
+
+static inline uint8_t twi_read_ack()
+{
+    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
+    twi_wait_complete();
+    return TWDR;
+}
+
+static inline uint8_t twi_read_nack()
+{
+    TWCR = (1 << TWINT) | (1 << TWEN);
+    twi_wait_complete();
+    return TWDR;
+}
+
+static inline uint8_t twi_get_status()
+{
+    return TWSR & 0xF8;
+}
+
+//len from 1
+static inline uint8_t i2c_read_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
+{
+    uint8_t res = 1;
+    twi_send_start();
+
+    if(TW_START != twi_get_status())
+        return res;
+
+    twi_write(dev_addr);
+    if(TW_MT_SLA_ACK != twi_get_status())
+        goto stop;
+
+    twi_write(reg_addr);
+    if(TW_MT_DATA_ACK != twi_get_status())
+        goto stop;
+
+    twi_send_start();
+    if(TW_REP_START != twi_get_status())
+        goto stop;
+
+    twi_write(dev_addr | 1);
+    if(TW_MR_SLA_ACK != twi_get_status())
+        goto stop;
+
+    while(-- len) {
+        *data ++ = twi_read_ack();
+        if(TW_MR_DATA_ACK != twi_get_status()) {
+            goto stop;
+        }
+    }
+
+    *data = twi_read_nack();
+    if(TW_MR_DATA_NACK != twi_get_status())
+        goto stop;
+
+    res = 0;
+
+stop:
+    twi_send_stop();
+    return res;
+}
+
+static inline uint8_t i2c_write_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
+{
+    uint8_t res = 1;
+    twi_send_start();
+
+    if(TW_START != twi_get_status())
+        return res;
+
+    twi_write(dev_addr);
+    if(TW_MT_SLA_ACK != twi_get_status())
+        goto stop;
+
+    twi_write(reg_addr);
+    if(TW_MT_DATA_ACK != twi_get_status())
+        goto stop;
+
+    while(len --) {
+        twi_write(*data ++);
+        if(TW_MT_DATA_ACK != twi_get_status()) {
+            goto stop;
+        }
+    }
+
+    res = 0;
+
+stop:
+    twi_send_stop();
+    return res;
+}
+
+#endif
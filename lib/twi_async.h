@@ -0,0 +1,231 @@
+#ifndef LIB_TWI_ASYNC_H
+#define LIB_TWI_ASYNC_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/twi.h>
+
+#include "twi.h"
+
+/*
+Interrupt-driven TWI (I2C) master: register reads and writes queued as
+transfers that the TWI ISR runs one after another, the CPU sleeps or
+works meanwhile.
+
+    static struct TWI_XFER x;
+    uint8_t buff[2];
+
+    twi_init();
+    i2c_read_reg_async(&x, 0x90, 0, buff, sizeof(buff), 0);
+    ...                                 //other work, the bytes move in the ISR
+    if(twi_wait(&x))                    //idle sleep until done
+        ...error: no ACK or bus error
+
+    i2c_read_reg_wait(0x90, 0, buff, 2);    //the two in one call
+
+The transfer and its buffer belong to the caller and must stay in scope
+until status is TWI_DONE or TWI_ERROR; the queue holds pointers only.
+done(), if set, runs in the ISR when the transfer ends: keep it short,
+e.g. post a lib/event.h event or start the next step of a sensor.
+
+Transfers run in the order queued, one START to STOP each, so sensors
+that queue their next transfer from done() take turns on the bus. A
+queued transfer follows the previous STOP with a START at once.
+
+The polled calls of lib/twi.h must not run while transfers are queued.
+twi_wait() sleeps in idle and puts the firmware's sleep mode back: the
+TWI does not wake the CPU from power-down or power-save.
+
+Options, define before including:
+    TWI_QUEUE_SIZE - power of two up to 128, default 4
+    TWI_EVENT      - lib/event.h event posted when a transfer ends
+*/
+
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE  4
+#endif
+
+#if TWI_QUEUE_SIZE & (TWI_QUEUE_SIZE - 1) || TWI_QUEUE_SIZE > 128
+#error "TWI_QUEUE_SIZE must be a power of two up to 128"
+#endif
+
+#ifdef TWI_EVENT
+#include "event.h"
+#endif
+
+#define TWI_QUEUE_MASK  (TWI_QUEUE_SIZE - 1)
+
+enum { TWI_QUEUED, TWI_BUSY, TWI_DONE, TWI_ERROR };
+
+struct TWI_XFER {
+    uint8_t dev;            //8-bit address, R/W bit clear
+    uint8_t reg;
+    uint8_t* data;
+    uint8_t len;            //from 1
+    uint8_t write;
+    volatile uint8_t status;
+    void (*done)(struct TWI_XFER* x);
+};
+
+static struct TWI_XFER* volatile twi_queue[TWI_QUEUE_SIZE];
+static volatile uint8_t twi_queue_head = 0;
+static volatile uint8_t twi_queue_tail = 0;
+//bytes of the current transfer moved
+static uint8_t twi_pos = 0;
+
+#define TWI_GO  ((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+
+static inline void twi_async_start()
+{
+    //a STOP still on the bus is sent first
+    while(TWCR & (1 << TWSTO));
+    twi_pos = 0;
+    twi_queue[twi_queue_tail]->status = TWI_BUSY;
+    TWCR = TWI_GO | (1 << TWSTA);
+}
+
+//ends the current transfer, STOP and the START of the next one in one step
+static inline void twi_async_finish(uint8_t status)
+{
+    uint8_t tail = twi_queue_tail;
+    struct TWI_XFER* x = twi_queue[tail];
+    tail = (tail + 1) & TWI_QUEUE_MASK;
+    twi_queue_tail = tail;
+    twi_pos = 0;
+    if(tail != twi_queue_head) {
+        twi_queue[tail]->status = TWI_BUSY;
+        TWCR = TWI_GO | (1 << TWSTO) | (1 << TWSTA);
+    } else {
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+    }
+    x->status = status;
+    if(x->done)
+        x->done(x);
+#ifdef TWI_EVENT
+    event_post(TWI_EVENT);
+#endif
+}
+
+ISR(TWI_vect)
+{
+    struct TWI_XFER* x = twi_queue[twi_queue_tail];
+    switch(TW_STATUS) {
+    case TW_START:
+        TWDR = x->dev;
+        TWCR = TWI_GO;
+        break;
+    case TW_MT_SLA_ACK:
+        TWDR = x->reg;
+        TWCR = TWI_GO;
+        break;
+    case TW_MT_DATA_ACK:
+        if(!x->write)
+            TWCR = TWI_GO | (1 << TWSTA);
+        else if(twi_pos < x->len) {
+            TWDR = x->data[twi_pos ++];
+            TWCR = TWI_GO;
+        } else
+            twi_async_finish(TWI_DONE);
+        break;
+    case TW_REP_START:
+        TWDR = x->dev | TW_READ;
+        TWCR = TWI_GO;
+        break;
+    case TW_MR_SLA_ACK:
+        //ACK all bytes but the last
+        TWCR = x->len > 1 ? TWI_GO | (1 << TWEA) : TWI_GO;
+        break;
+    case TW_MR_DATA_ACK:
+        x->data[twi_pos ++] = TWDR;
+        TWCR = twi_pos + 1 < x->len ? TWI_GO | (1 << TWEA) : TWI_GO;
+        break;
+    case TW_MR_DATA_NACK:
+        x->data[twi_pos] = TWDR;
+        twi_async_finish(TWI_DONE);
+        break;
+    default:
+        //no ACK, arbitration lost, bus error
+        twi_async_finish(TWI_ERROR);
+        break;
+    }
+}
+
+//returns 1 if the queue is full
+static inline uint8_t twi_submit(struct TWI_XFER* x)
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t head = twi_queue_head;
+    uint8_t next = (head + 1) & TWI_QUEUE_MASK;
+    if(next == twi_queue_tail) {
+        SREG = sreg;
+        return 1;
+    }
+    x->status = TWI_QUEUED;
+    twi_queue[head] = x;
+    twi_queue_head = next;
+    if(head == twi_queue_tail)
+        twi_async_start();
+    SREG = sreg;
+    return 0;
+}
+
+static inline uint8_t i2c_read_reg_async(struct TWI_XFER* x, uint8_t dev_addr, uint8_t reg_addr,
+        uint8_t* data, uint8_t len, void (*done)(struct TWI_XFER* x))
+{
+    x->dev = dev_addr;
+    x->reg = reg_addr;
+    x->data = data;
+    x->len = len;
+    x->write = 0;
+    x->done = done;
+    return twi_submit(x);
+}
+
+static inline uint8_t i2c_write_reg_async(struct TWI_XFER* x, uint8_t dev_addr, uint8_t reg_addr,
+        uint8_t* data, uint8_t len, void (*done)(struct TWI_XFER* x))
+{
+    x->dev = dev_addr;
+    x->reg = reg_addr;
+    x->data = data;
+    x->len = len;
+    x->write = 1;
+    x->done = done;
+    return twi_submit(x);
+}
+
+//0 - done, 1 - error, as i2c_read_reg()
+static inline uint8_t twi_wait(struct TWI_XFER* x)
+{
+    uint8_t smcr = SMCR;
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    while(x->status < TWI_DONE) {
+        sei();
+        sleep_cpu();
+        cli();
+    }
+    SMCR = smcr;
+    sei();
+    return TWI_ERROR == x->status;
+}
+
+//i2c_read_reg() and i2c_write_reg() with the CPU asleep during the transfer
+static inline uint8_t i2c_read_reg_wait(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
+{
+    struct TWI_XFER x;
+    if(i2c_read_reg_async(&x, dev_addr, reg_addr, data, len, 0))
+        return 1;
+    return twi_wait(&x);
+}
+
+static inline uint8_t i2c_write_reg_wait(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
+{
+    struct TWI_XFER x;
+    if(i2c_write_reg_async(&x, dev_addr, reg_addr, data, len, 0))
+        return 1;
+    return twi_wait(&x);
+}
+
+#endif
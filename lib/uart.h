@@ -0,0 +1,48 @@
+#ifndef LIB_UART_H
+#define LIB_UART_H
+
+#include <avr/io.h>
+
+#include "power.h"
+#include "uart_baud.h"
+#include "uart_tx.h"
+
+/*
+UART on at UART_BAUD (lib/uart_baud.h), 8 data bits, 1 stop bit, no parity.
+
+    uart_init(0);   //transmit only, lib/uart_tx.h
+    uart_init(1);   //also receive, with the RX complete interrupt of lib/uart_rx.h
+
+The argument is a constant at every call, the branch does not reach the code.
+uart_init() claims the USART (lib/power.h). Text printed before it stays in
+the lib/uart_tx.h ring and goes out from here on: UDRIE is set again.
+*/
+
+#ifdef UDR0
+#define UART_UCSRB      UCSR0B
+#define UART_UCSRC      UCSR0C
+#define UART_RXEN       RXEN0
+#define UART_TXEN       TXEN0
+#define UART_RXCIE      RXCIE0
+#define UART_UCSZ1      UCSZ01
+#define UART_UCSZ0      UCSZ00
+#else
+#define UART_UCSRB      UCSRB
+#define UART_UCSRC      UCSRC
+#define UART_RXEN       RXEN
+#define UART_TXEN       TXEN
+#define UART_RXCIE      RXCIE
+#define UART_UCSZ1      UCSZ1
+#define UART_UCSZ0      UCSZ0
+#endif
+
+static inline void uart_init(uint8_t rx)
+{
+    power_claim(POWER_USART0);
+    uart_baud_init();
+    UART_UCSRB = (rx ? (1 << UART_RXEN) | (1 << UART_TXEN) | (1 << UART_RXCIE) : (1 << UART_TXEN))
+        | uart_tx_udrie();
+    UART_UCSRC = (1 << UART_UCSZ1) | (1 << UART_UCSZ0);
+}
+
+#endif
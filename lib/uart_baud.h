@@ -0,0 +1,70 @@
+#ifndef LIB_UART_BAUD_H
+#define LIB_UART_BAUD_H
+
+#include <avr/io.h>
+
+/*
+UART baud rate from F_CPU, picked at compile time.
+
+UBRR is rounded to the nearest divisor instead of truncated. U2X (8
+samples per bit instead of 16) is used when it gets closer to the asked
+rate, e.g. 1000000 baud at 8 MHz. At the same error the normal mode is
+kept, it tolerates more clock mismatch on receive.
+
+    8 MHz:  38400 (0.2 %), 250000, 500000, 1000000 (U2X)
+    1 MHz:  9600 (U2X, 0.2 %), 62500; 38400 is 8.5 % off
+
+Options, define before including:
+    UART_BAUD       - rate set by uart_baud_init(), default 38400; the
+                      build fails if F_CPU does not reach it within
+                      UART_BAUD_TOL
+    UART_BAUD_TOL   - max. baud rate error, per mille, default 20
+*/
+
+#ifndef UART_BAUD
+#define UART_BAUD       38400UL
+#endif
+
+#ifndef UART_BAUD_TOL
+#define UART_BAUD_TOL   20
+#endif
+
+#ifdef UDR0
+#define UART_BAUD_UBRRH UBRR0H
+#define UART_BAUD_UBRRL UBRR0L
+#define UART_BAUD_UCSRA UCSR0A
+#define UART_BAUD_U2X   U2X0
+#else
+#define UART_BAUD_UBRRH UBRRH
+#define UART_BAUD_UBRRL UBRRL
+#define UART_BAUD_UCSRA UCSRA
+#define UART_BAUD_U2X   U2X
+#endif
+
+//UBRR + 1, rounded; x - 1 for U2X
+#define UART_DIV(f, b, x)   (((f) + (b) * (8UL >> (x))) / ((b) * (16UL >> (x))))
+#define UART_UBRR(f, b, x)  (UART_DIV(f, b, x) - 1)
+//rate actually set; UART_DIV 0 (b above the reach of F_CPU) is caught by UART_BAUD_OK
+#define UART_RATE(f, b, x)  ((f) / ((16UL >> (x)) * (UART_DIV(f, b, x) ? UART_DIV(f, b, x) : 1)))
+//error, per mille
+#define UART_ERR(f, b, x)   ((UART_RATE(f, b, x) > (b) ? UART_RATE(f, b, x) - (b) : (b) - UART_RATE(f, b, x)) * 1000 / (b))
+#define UART_U2X(f, b)      (UART_ERR(f, b, 1) < UART_ERR(f, b, 0))
+#define UART_BAUD_OK(f, b)  (UART_DIV(f, b, UART_U2X(f, b)) >= 1 && UART_DIV(f, b, UART_U2X(f, b)) <= 4096 \
+                                && UART_ERR(f, b, UART_U2X(f, b)) <= UART_BAUD_TOL)
+
+_Static_assert(UART_BAUD_OK(F_CPU, UART_BAUD), "UART_BAUD is not reachable from F_CPU within UART_BAUD_TOL");
+
+//UCSRA written as a whole: U2X, MPCM off, TXC not cleared
+static inline void uart_baud_set(uint16_t ubrr, uint8_t u2x)
+{
+    UART_BAUD_UBRRH = ubrr >> 8;
+    UART_BAUD_UBRRL = ubrr;
+    UART_BAUD_UCSRA = u2x ? (1 << UART_BAUD_U2X) : 0;
+}
+
+static inline void uart_baud_init()
+{
+    uart_baud_set(UART_UBRR(F_CPU, UART_BAUD, UART_U2X(F_CPU, UART_BAUD)), UART_U2X(F_CPU, UART_BAUD));
+}
+
+#endif
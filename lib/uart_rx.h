@@ -0,0 +1,101 @@
+#ifndef LIB_UART_RX_H
+#define LIB_UART_RX_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "isr_stat.h"
+#ifdef UART_RX_EVENT
+#include "event.h"
+#endif
+
+/*
+UART receive through a ring buffer filled by the RX complete interrupt.
+
+Bytes that arrive while the main loop is busy (register dumps, sensor
+reads, delays) are kept until uart_rx_read() picks them up. When the ring
+is full new bytes are dropped and counted in uart_rx_overruns.
+
+The firmware sets up the baud rate and enables RXEN and RXCIE itself.
+Each received byte wakes the CPU from idle sleep.
+
+Options, define before including:
+    UART_RX_RING_SIZE - power of two up to 128, default 8 on parts with
+                        128 bytes of SRAM (ATtiny2313), 32 otherwise
+    UART_RX_ISR_STAT  - lib/isr_stat.h slot of the RX ISR
+    UART_RX_EVENT     - lib/event.h event posted for each received byte
+*/
+
+#ifdef UDR0
+#define UART_RX_UDR     UDR0
+#define UART_RX_UCSRA   UCSR0A
+#define UART_RX_DOR     DOR0
+#else
+#define UART_RX_UDR     UDR
+#define UART_RX_UCSRA   UCSRA
+#define UART_RX_DOR     DOR
+#endif
+
+#ifndef UART_RX_RING_SIZE
+#if RAMEND < 0x100
+#define UART_RX_RING_SIZE   8
+#else
+#define UART_RX_RING_SIZE   32
+#endif
+#endif
+
+#if UART_RX_RING_SIZE & (UART_RX_RING_SIZE - 1) || UART_RX_RING_SIZE > 128
+#error "UART_RX_RING_SIZE must be a power of two up to 128"
+#endif
+
+#define UART_RX_RING_MASK   (UART_RX_RING_SIZE - 1)
+
+#ifndef UART_RX_ISR_STAT
+#define UART_RX_ISR_STAT    ISR_STAT_NONE
+#endif
+
+static volatile uint8_t uart_rx_ring[UART_RX_RING_SIZE];
+static volatile uint8_t uart_rx_head = 0; //written by the ISR
+static volatile uint8_t uart_rx_tail = 0; //written by uart_rx_read()
+//bytes lost: ring full, or the hardware overrun (DOR) before the ISR ran
+static volatile uint8_t uart_rx_overruns = 0;
+
+ISR(USART_RX_vect)
+{
+    ISR_STAT_ENTER();
+    //DOR must be read before UDR
+    if(UART_RX_UCSRA & (1 << UART_RX_DOR))
+        uart_rx_overruns ++;
+    uint8_t data = UART_RX_UDR;
+    uint8_t head = uart_rx_head;
+    uint8_t next = (head + 1) & UART_RX_RING_MASK;
+    if(next == uart_rx_tail) {
+        uart_rx_overruns ++;
+    }
+    else {
+        uart_rx_ring[head] = data;
+        uart_rx_head = next;
+    }
+#ifdef UART_RX_EVENT
+    event_post(UART_RX_EVENT);
+#endif
+    ISR_STAT_LEAVE(UART_RX_ISR_STAT);
+}
+
+static inline uint8_t uart_rx_available()
+{
+    return uart_rx_head != uart_rx_tail;
+}
+
+//returns 0 if nothing was received
+static inline uint8_t uart_rx_read(uint8_t* data)
+{
+    uint8_t tail = uart_rx_tail;
+    if(tail == uart_rx_head)
+        return 0;
+    *data = uart_rx_ring[tail];
+    uart_rx_tail = (tail + 1) & UART_RX_RING_MASK;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef LIB_UART_TX_H
+#define LIB_UART_TX_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "isr_stat.h"
+
+/*
+UART transmit through a ring buffer drained by the UDRE interrupt.
+
+uart_tx() only waits when the ring is full, so a print costs a few cycles
+per byte instead of one byte time (260 us at 38400 baud). The UDRE
+interrupt wakes the CPU from idle sleep after every byte: main loops must
+not treat any wakeup as a timer tick, use a flag set by the timer ISR.
+
+Call uart_tx_flush() before power-down or power-save sleep (the UART
+clock stops) and before changing the clock prescaler (the baud rate
+changes under the bytes still queued).
+
+Options, define before including:
+    UART_TX_RING_SIZE - power of two up to 128, default 16 on parts with
+                        128 bytes of SRAM (ATtiny2313), 128 otherwise
+    UART_TX_POLLED    - old busy-wait path, to compare cycle counts
+    UART_TX_ISR_STAT  - lib/isr_stat.h slot of the UDRE ISR
+
+The firmware still sets up the baud rate and enables TXEN itself, with
+lib/uart.h or by hand. A UCSRB write clears UDRIE: OR in uart_tx_udrie(),
+or the bytes queued before it wait for the next uart_tx().
+*/
+
+#ifdef UDR0
+#define UART_TX_UDR     UDR0
+#define UART_TX_UCSRA   UCSR0A
+#define UART_TX_UCSRB   UCSR0B
+#define UART_TX_UDRE    UDRE0
+#define UART_TX_UDRIE   UDRIE0
+#define UART_TX_TXC     TXC0
+#define UART_TX_U2X     U2X0
+#define UART_TX_MPCM    MPCM0
+#else
+#define UART_TX_UDR     UDR
+#define UART_TX_UCSRA   UCSRA
+#define UART_TX_UCSRB   UCSRB
+#define UART_TX_UDRE    UDRE
+#define UART_TX_UDRIE   UDRIE
+#define UART_TX_TXC     TXC
+#define UART_TX_U2X     U2X
+#define UART_TX_MPCM    MPCM
+#endif
+
+//set while the last byte written to UDR may still be shifting out
+static volatile uint8_t uart_tx_active = 0;
+
+//write UDR and clear TXC in the same step, U2X and MPCM kept, error flags written as 0
+static inline void uart_tx_write(uint8_t data)
+{
+    UART_TX_UDR = data;
+    UART_TX_UCSRA = (UART_TX_UCSRA & ((1 << UART_TX_U2X) | (1 << UART_TX_MPCM))) | (1 << UART_TX_TXC);
+    uart_tx_active = 1;
+}
+
+#ifdef UART_TX_POLLED
+
+static inline void uart_tx(uint8_t data)
+{
+    while(!(UART_TX_UCSRA & (1 << UART_TX_UDRE)));
+    uart_tx_write(data);
+}
+
+static inline uint8_t uart_tx_udrie()
+{
+    return 0;
+}
+
+static inline void uart_tx_flush()
+{
+    if(uart_tx_active)
+        while(!(UART_TX_UCSRA & (1 << UART_TX_TXC)));
+    uart_tx_active = 0;
+}
+
+#else
+
+#ifndef UART_TX_RING_SIZE
+#if RAMEND < 0x100
+#define UART_TX_RING_SIZE   16
+#else
+#define UART_TX_RING_SIZE   128
+#endif
+#endif
+
+#if UART_TX_RING_SIZE & (UART_TX_RING_SIZE - 1) || UART_TX_RING_SIZE > 128
+#error "UART_TX_RING_SIZE must be a power of two up to 128"
+#endif
+
+#define UART_TX_RING_MASK   (UART_TX_RING_SIZE - 1)
+
+#ifndef UART_TX_ISR_STAT
+#define UART_TX_ISR_STAT    ISR_STAT_NONE
+#endif
+
+static volatile uint8_t uart_tx_ring[UART_TX_RING_SIZE];
+static volatile uint8_t uart_tx_head = 0; //written by uart_tx()
+static volatile uint8_t uart_tx_tail = 0; //written by the ISR
+
+static inline void uart_tx_next()
+{
+    uint8_t tail = uart_tx_tail;
+    //UDRIE may be set again by uart_tx() racing with the clear below
+    if(tail == uart_tx_head) {
+        UART_TX_UCSRB &= ~(1 << UART_TX_UDRIE);
+        return;
+    }
+    uart_tx_write(uart_tx_ring[tail]);
+    tail = (tail + 1) & UART_TX_RING_MASK;
+    uart_tx_tail = tail;
+    if(tail == uart_tx_head)
+        UART_TX_UCSRB &= ~(1 << UART_TX_UDRIE);
+}
+
+ISR(USART_UDRE_vect)
+{
+    ISR_STAT_ENTER();
+    uart_tx_next();
+    ISR_STAT_LEAVE(UART_TX_ISR_STAT);
+}
+
+static inline void uart_tx(uint8_t data)
+{
+    uint8_t head = uart_tx_head;
+    uint8_t next = (head + 1) & UART_TX_RING_MASK;
+    while(next == uart_tx_tail) {
+        //full with interrupts off: drain by hand instead of dead-locking
+        if(!(SREG & (1 << SREG_I)) && (UART_TX_UCSRA & (1 << UART_TX_UDRE)))
+            uart_tx_next();
+    }
+    uart_tx_ring[head] = data;
+    uart_tx_head = next;
+    UART_TX_UCSRB |= (1 << UART_TX_UDRIE);
+}
+
+//UDRIE while the ring holds bytes, for a write of the whole UCSRB
+static inline uint8_t uart_tx_udrie()
+{
+    return uart_tx_head != uart_tx_tail ? 1 << UART_TX_UDRIE : 0;
+}
+
+//wait until the ring is empty and the last stop bit is out
+static inline void uart_tx_flush()
+{
+    while(uart_tx_head != uart_tx_tail) {
+        if(!(SREG & (1 << SREG_I)) && (UART_TX_UCSRA & (1 << UART_TX_UDRE)))
+            uart_tx_next();
+    }
+    if(uart_tx_active)
+        while(!(UART_TX_UCSRA & (1 << UART_TX_TXC)));
+    uart_tx_active = 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#include <avr/io.h>
+
+#include "lib/spi.h"
+
+/*
+Hand-written masks from the tests, the reference for "make pin_check".
+pin_check.cpp has the same functions on lib/pin.hpp, the two listings
+must match instruction for instruction.
+*/
+
+#define LORA_RST        (1 << PB0)
+#define LORA_RX_TX_DONE (1 << PB1)
+#define LED_PIN         (1 << PC0)
+
+//test12, test13
+void si4432_ddr()
+{
+    DDRB = 0b101101;
+}
+
+//test13
+void si4432_cs_low()
+{
+    PORTB &= ~0b00000100;
+}
+
+void si4432_cs_high()
+{
+    PORTB |= 0b00000100;
+}
+
+//test07
+void lora_reset_pulse()
+{
+    PORTB &= ~LORA_RST;
+    PORTB |= LORA_RST;
+}
+
+uint8_t lora_check_dio0()
+{
+    return !!(PINB & LORA_RX_TX_DONE);
+}
+
+void lora_wait_dio0()
+{
+    while(!(PINB & LORA_RX_TX_DONE));
+}
+
+void led_init()
+{
+    DDRC |= LED_PIN;
+}
+
+void led_toggle()
+{
+    PINC = LED_PIN;
+}
+
+//test06
+void lcd_reset()
+{
+    PORTB = 0b000000;
+}
+
+void btn_init()
+{
+    DDRC = 0b00000000;
+    PORTC = 0b01000011;
+}
+
+uint8_t btn_get_state()
+{
+    return PINC & 0b00000011;
+}
+
+//lib/spi.h, chip select on PB2
+uint8_t spi_dev_read_reg(uint8_t reg)
+{
+    return spi_read_reg(reg);
+}
@@ -0,0 +1,78 @@
+#include "lib/pin.hpp"
+#include "lib/spi_dev.hpp"
+
+/*
+pin_check.c on lib/pin.hpp, see "make pin_check".
+*/
+
+using LoraRst   = Pin<PortB, 0>;
+using LoraDio0  = Pin<PortB, 1>;
+using Si4432Cs  = Pin<PortB, 2>;
+using Led       = Pin<PortC, 0>;
+using Btn       = Pins<PortC, 0, 1>;
+
+extern "C" {
+
+void si4432_ddr()
+{
+    Pins<PortB, 0, 2, 3, 5>::set_ddr();
+}
+
+void si4432_cs_low()
+{
+    Si4432Cs::low();
+}
+
+void si4432_cs_high()
+{
+    Si4432Cs::high();
+}
+
+void lora_reset_pulse()
+{
+    LoraRst::low();
+    LoraRst::high();
+}
+
+uint8_t lora_check_dio0()
+{
+    return LoraDio0::is_high();
+}
+
+void lora_wait_dio0()
+{
+    while(!LoraDio0::read());
+}
+
+void led_init()
+{
+    Led::output();
+}
+
+void led_toggle()
+{
+    Led::toggle();
+}
+
+void lcd_reset()
+{
+    Pins<PortB>::set_port();
+}
+
+void btn_init()
+{
+    Pins<PortC>::set_ddr();
+    Pins<PortC, 0, 1, 6>::set_port();
+}
+
+uint8_t btn_get_state()
+{
+    return Btn::read();
+}
+
+uint8_t spi_dev_read_reg(uint8_t reg)
+{
+    return SpiDev<Si4432Cs>::read_reg(reg);
+}
+
+}
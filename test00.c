@@ -4,6 +4,9 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 
+//make 00_isr_stat: TIMER0_COMPA run time in the EEPROM, see lib/isr_stat.h
+#include "lib/isr_stat.h"
+
 /*
 	7 x 8 LED (Vf=3.5@20ma) matrix
 	PD0-6 - LED[0-6][0-7] + PB0-7 
@@ -21,6 +24,7 @@ static void sys_init() {
 	TIFR |= 0x01;
 	TIMSK = 0x01;
 	TCCR0B = 0x01;
+	isr_stat_init();
 	sei();
 }
 
@@ -28,6 +32,7 @@ static void sys_init() {
 static uint8_t b[7];
 
 ISR(TIMER0_COMPA_vect) {
+	ISR_STAT_ENTER();
 	static uint8_t i = 0;
 	PORTD = 0b1111111;
 	PORTB = b[i];
@@ -36,6 +41,7 @@ ISR(TIMER0_COMPA_vect) {
 	if(i == 7) {
 		i = 0;
 	}
+	ISR_STAT_LEAVE(0);
 }
 
 static void fast_s_l() {
@@ -196,6 +202,7 @@ int main (void) {
 		fill_s_l();
 		fast_r();
 		fill_s_r();
+		isr_stat_autosave();
 	}
 }
 
@@ -5,6 +5,9 @@
 #include <avr/sleep.h>
 #include <util/delay.h>
 
+//make 01_isr_stat: PCINT run time in the EEPROM, see lib/isr_stat.h
+#include "lib/isr_stat.h"
+
 /*
 	"Digital Candels" with coin payment
 	
@@ -41,24 +44,23 @@ static void sys_init() {
 	GIMSK |= (1 << PCIE);  //pin change interrupt enable
 	PCMSK |= (1 << PCINT0);  //pin change interrupt 0 (PB0)
 	MCUCR |= (1 << SE) | (1 << SM0);  //sleep enable, power down mode
+	isr_stat_init();
 	sei();  //enable interrupts
 }
 
 ISR(PCINT_vect) {
-	if(debounce) {
-		return;
-	}
-	if(PINB & 0b00000001) {
-		return;
-	}
-	debounce = 0xFF;
-	uint8_t i = sizeof(tm) / sizeof(tm[0]);
-	while(i--) {
-		if(!tm[i]) {
-			tm[i] = CANDLE_ON_TIME;
-			break;
+	ISR_STAT_ENTER();
+	if(!debounce && !(PINB & 0b00000001)) {
+		debounce = 0xFF;
+		uint8_t i = sizeof(tm) / sizeof(tm[0]);
+		while(i--) {
+			if(!tm[i]) {
+				tm[i] = CANDLE_ON_TIME;
+				break;
+			}
 		}
 	}
+	ISR_STAT_LEAVE(0);
 }
 
 static uint8_t oscilate() {
@@ -88,7 +90,8 @@ static void check_candle_times() {
 		}
 	}
 	if(!cnt) {
-		sleep_cpu();
+		isr_stat_autosave();
+		isr_stat_sleep();
 	}
 }
 
@@ -65,7 +65,9 @@ static void process_button_down() {
 		_delay_ms(50);
 	}
 	run = !run;
-	_delay_ms(1000);
+	//one full WDT period in power-down, the WDT is the only interrupt
+	wdt_reset();
+	sleep_cpu();
 	flash_fast(run ? 2:5);
 }
 
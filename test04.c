@@ -5,6 +5,14 @@
 #include <avr/sleep.h>
 #include <util/delay.h>
 
+//UBRR 0, the fastest rate at 8 MHz without U2X
+#define UART_BAUD 500000UL
+#include "lib/uart_baud.h"
+#include "lib/uart_tx.h"
+#include "lib/uart_rx.h"
+#include "lib/cmd_line.h"
+#include "lib/cobs.h"
+
 
 //PD0 RX
 //PD1 TX
@@ -20,9 +28,7 @@
 static void sys_init() {
 	DDRD = 0b1100;
 
-	//Baud rate 57600 for 1 MHZ, 460800 for 8MHZ
-	UBRRL = 0;
-	UBRRH = 0;
+	uart_baud_init();
 
 	//8 data bits, 1 stop bit
 	UCSRC = (1 << UCSZ1) | (1 << UCSZ0);
@@ -31,17 +37,11 @@ static void sys_init() {
 	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
 	
 	//Enable UART and interrupt on receive
-	UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE);
+	UCSRB = (1 << RXEN) | (1 << TXEN) | (1 << RXCIE) | uart_tx_udrie();
 	sei();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-static void uart_tx(uint8_t data)
-{
-	while (!(UCSRA & (1 << UDRE)));
-	UDR = data;
-}
-
 //static uint8_t uart_rx()
 //{
 //	while(!(UCSRA & (1 << RXC)));
@@ -49,18 +49,14 @@ static void uart_tx(uint8_t data)
 //	return UDR;
 //}
 
-ISR(USART_RX_vect)
-{
-}
-
 ///////////////////////////////////////////////////////////////////////////////
 static void p_nibble(uint8_t val) {
-	static const uint8_t xx[] = {
+	static const uint8_t xx[] PROGMEM = {
 		'0', '1', '2', '3', '4', '5', '6', '7',
 		'8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
 	};
 	val &= 0b1111;
-	uart_tx(xx[val]);
+	uart_tx(pgm_read_byte(&xx[val]));
 }
 
 static void p_uint8(uint8_t val) {
@@ -148,8 +144,8 @@ static uint16_t sht1x_ut = 0, sht1x_uh = 0;
 
 //func, inst, cnt, val
 
-static void sht1x_print() {
-	static uint16_t sht1x_tt = 0;
+//"$ 00 00 cnt temp hum", 24 bytes
+static void sht1x_print(uint16_t cnt) {
 	//start
 	uart_tx('$');
 	uart_tx(' ');
@@ -160,7 +156,7 @@ static void sht1x_print() {
 	p_uint8(0);
 	uart_tx(' ');
 	//counter
-	p_uint16(sht1x_tt);
+	p_uint16(cnt);
 	uart_tx(' ');
 	//temperature
 	p_uint16(sht1x_ut);
@@ -169,26 +165,67 @@ static void sht1x_print() {
 	p_uint16(sht1x_uh);
 	uart_tx('\r');
 	uart_tx('\n');
+}
+
+//the same record in a COBS frame, 13 bytes
+static void sht1x_send(uint16_t cnt) {
+	uint8_t rec[] = {
+		0, 0, //function, instance
+		cnt, cnt >> 8,
+		sht1x_ut, sht1x_ut >> 8,
+		sht1x_uh, sht1x_uh >> 8
+	};
+	uint8_t frame[COBS_FRAME_LEN(sizeof(rec))];
+	uint8_t len = cobs_frame(frame, rec, sizeof(rec));
+	for(uint8_t i = 0; i < len; i ++)
+		uart_tx(frame[i]);
+}
+
+static uint8_t g_binary = 0;
+
+static void sht1x_measure() {
+	static uint16_t sht1x_tt = 0;
+	sht1x_start(0b00000011);
+	sht1x_wait_result();
+	sht1x_ut = sht1x_read();
+	sht1x_start(0b00000101);
+	sht1x_wait_result();
+	sht1x_uh = sht1x_read();
+	if(g_binary)
+		sht1x_send(sht1x_tt);
+	else
+		sht1x_print(sht1x_tt);
 	sht1x_tt ++;
 }
 
+//"r" - one reading, "r N" - N readings
+//"a" - ASCII records (default), "b" - binary records
+static struct CMD_LINE g_cmd;
+
+static void f_cmd() {
+	if(cmd_line_is_P(&g_cmd, PSTR("r"))) {
+		uint16_t cnt = g_cmd.argc ? g_cmd.argv[0] : 1;
+		while(cnt --)
+			sht1x_measure();
+	}
+	else if(cmd_line_is_P(&g_cmd, PSTR("a")))
+		g_binary = 0;
+	else if(cmd_line_is_P(&g_cmd, PSTR("b")))
+		g_binary = 1;
+}
+
 int main()
 {
 	sys_init();
 
 	while(1) {
+		//power-down stops the UART clock
+		uart_tx_flush();
 		sleep_cpu();
-		if(UCSRA & (1 << RXC)) {
-			uint8_t ch = UDR;
-			if(ch == 'r') {
-				sht1x_start(0b00000011);
-				sht1x_wait_result();
-				sht1x_ut = sht1x_read();
-				sht1x_start(0b00000101);
-				sht1x_wait_result();
-				sht1x_uh = sht1x_read();
-				sht1x_print();
-			}
+		uint8_t ch;
+		while(uart_rx_read(&ch)) {
+			if(CMD_LINE_READY == cmd_line_feed(&g_cmd, ch))
+				f_cmd();
 		}
 	}
 	return 0;
@@ -5,6 +5,21 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//lib/isr_stat.h slots, recorded with "make 05_isr_stat"
+#define ISR_SLOT_TIMER2     0
+#define UART_RX_ISR_STAT    1
+#define UART_TX_ISR_STAT    2
+
+#define UART_BAUD 38400UL
+#include "lib/power.h"
+#include "lib/uart.h"
+#include "lib/uart_tx.h"
+#include "lib/print.h"
+#include "lib/uart_rx.h"
+#define CMD_LINE_ARGS_MAX 3
+#include "lib/cmd_line.h"
+#include "lib/isr_stat_print.h"
+
 /*
 ATMEGA 328P
     RTC: 9-10 32768 Hz QZ 
@@ -14,6 +29,7 @@ ATMEGA 328P
 
 static void rtc_init(void)
 {  
+    power_claim(POWER_TIMER2);
     TCCR2A = 0x00;  //overflow
     TCCR2B = 0x05;  //5 gives 1 sec. prescale 
     TIMSK2 = 0x01;  //enable timer2A overflow interrupt
@@ -21,22 +37,6 @@ static void rtc_init(void)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
-
-static void uart_init() {
-    UBRR0H = (uint8_t) (USART_UBBR_VALUE >> 8);
-    UBRR0L = (uint8_t) USART_UBBR_VALUE;
-
-    UCSR0A = 0;
-    
-
-    //Enable UART
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
-
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-}
 
 //static uint8_t uart_rx()
 //{
@@ -45,25 +45,7 @@ static void uart_init() {
 //  return UDR0;
 //}
 
-static void uart_tx(uint8_t data)
-{
-    while (!(UCSR0A & (1 << UDRE0)));
-    UDR0 = data;
-}
-
-static void p_line(const char* pp) {
-    while(*pp) {
-        uart_tx(*pp++);
-    }
-    uart_tx('\r');
-    uart_tx('\n');
-}
-
 ///////////////////////////////////////////////////////////////////////////////
-//Interrupts
-ISR(USART_RX_vect)
-{
-}
 
 struct {
     uint8_t s0 : 4;
@@ -89,6 +71,21 @@ static void reset_time()
     TCNT2 = 0; //zero RTC counter
 }
 
+//returns 1 if out of range
+static uint8_t set_time(uint16_t h, uint16_t m, uint16_t s)
+{
+    if(h > 23 || m > 59 || s > 59)
+        return 1;
+    reset_time();
+    tm.h1 = h / 10;
+    tm.h0 = h % 10;
+    tm.m1 = m / 10;
+    tm.m0 = m % 10;
+    tm.s1 = s / 10;
+    tm.s0 = s % 10;
+    return 0;
+}
+
 static void update_time()
 {
     if(++tm.s0 == 10) {
@@ -119,53 +116,77 @@ static void update_time()
     }
 }
 
+static volatile uint8_t g_rtc_tick = 0;
+
 ISR(TIMER2_OVF_vect)
 {
+    ISR_STAT_ENTER();
+    g_rtc_tick = 1;
+    ISR_STAT_LEAVE(ISR_SLOT_TIMER2);
 }
 
 static void p_time() {
-    static const uint8_t num_arr[] = {
-        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9'
-    };
-    uart_tx(num_arr[tm.d1]);
-    uart_tx(num_arr[tm.d0]);
+    uart_tx('0' + tm.d1);
+    uart_tx('0' + tm.d0);
     uart_tx(':');
-    uart_tx(num_arr[tm.h1]);
-    uart_tx(num_arr[tm.h0]);
+    uart_tx('0' + tm.h1);
+    uart_tx('0' + tm.h0);
     uart_tx(':');
-    uart_tx(num_arr[tm.m1]);
-    uart_tx(num_arr[tm.m0]);
+    uart_tx('0' + tm.m1);
+    uart_tx('0' + tm.m0);
     uart_tx(':');
-    uart_tx(num_arr[tm.s1]);
-    uart_tx(num_arr[tm.s0]);
-    uart_tx('\r');
-    uart_tx('\n');
+    uart_tx('0' + tm.s1);
+    uart_tx('0' + tm.s0);
+    p_crlf();
 }
 
 static void sys_init() {
     cli();
+    power_init();
     set_sleep_mode(SLEEP_MODE_IDLE);
     sleep_enable();
-    uart_init();
+    uart_init(1);
     rtc_init();
+    isr_stat_init();
     sei();
 }
 
+static struct CMD_LINE g_cmd;
+
+static void f_cmd(uint8_t res)
+{
+    if(CMD_LINE_READY == res && cmd_line_is_P(&g_cmd, PSTR(""))) {
+        p_line_P(PSTR("RTC reset"));
+        reset_time();
+    }
+    else if(CMD_LINE_READY == res && cmd_line_is_P(&g_cmd, PSTR("t")) && 3 == g_cmd.argc
+            && !set_time(g_cmd.argv[0], g_cmd.argv[1], g_cmd.argv[2])) {
+        p_line_P(PSTR("RTC set"));
+    }
+#ifdef ISR_STAT_SLOTS
+    else if(CMD_LINE_READY == res && cmd_line_is_P(&g_cmd, PSTR("i"))) {
+        isr_stat_print(ISR_SLOT_TIMER2, PSTR("timer2 "));
+        isr_stat_print(UART_RX_ISR_STAT, PSTR("uart_rx"));
+        isr_stat_print(UART_TX_ISR_STAT, PSTR("uart_tx"));
+    }
+#endif
+    else {
+        p_line_P(PSTR("Press <ENTER> to reset RTC, t h m s <ENTER> to set it"));
+    }
+}
+
 int main(void) {
     sys_init();
     while(1) {
-        sleep_cpu();
-        if(UCSR0A & (1 << RXC0)) {
-            uint8_t ch = UDR0;
-            if(ch == '\r') {
-                p_line("RTC reset");
-                reset_time();
-            }
-            else {
-                p_line("Press <ENTER> to reset RTC");
-            }
+        uint8_t ch;
+        isr_stat_sleep();
+        while(uart_rx_read(&ch)) {
+            uint8_t res = cmd_line_feed(&g_cmd, ch);
+            if(CMD_LINE_NONE != res)
+                f_cmd(res);
         }
-        else {
+        if(g_rtc_tick) {
+            g_rtc_tick = 0;
             update_time();
             p_time();
         }
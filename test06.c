@@ -5,6 +5,11 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//TODO: the PCD8544 takes SCK up to 4 MHz, try 2
+#define SPI_CLOCK_DIV   16
+#include "lib/power.h"
+#include "lib/spi_async.h"
+
 /*
    ATMEGA 328P + Nokia5110 LCD
    PB0 -- LCD-RST
@@ -30,20 +35,6 @@ static uint8_t lib_rand_6()
     return 1 + (val >> 1);
 }
 
-static void spi_init()
-{
-    DDRB = 0b00101111; //output CLK, MOSI, SS, LCD-DC, LCD-RST
-    SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPI2X); //enable SPI-master, clock/2 speed
-    //TODO: Wrong initialzation! Use this for fast SPI:
-    //SPSR = SPI2X; //clk / 2
-    //SPCR = (1 << SPE) | (1 << MSTR);
-}
-
-static void spi_wait_write()
-{
-    while(!(SPSR & (1 << SPIF))); //wait for write end
-}
-
 static void spi_write_byte(uint8_t data)
 {
     SPDR = data;
@@ -89,19 +80,33 @@ static void lcd_set_data_mode()
 
 static void rtc_init(void)
 {
+    power_claim(POWER_TIMER2);
     TCCR2A = 0x00;  //overflow
     TCCR2B = 0x02;  //5 gives 1 sec. prescale 
     TIMSK2 = 0x01;  //enable timer2A overflow interrupt
     ASSR  = 0x20;   //enable asynchronous mode
 }
 
+static volatile uint8_t g_rtc_tick = 0;
+
 ISR(TIMER2_OVF_vect)
 {
+    g_rtc_tick = 1;
+}
+
+//sleep until the next RTC overflow, the SPI interrupts wake the CPU as well
+static void rtc_wait()
+{
+    g_rtc_tick = 0;
+    while(!g_rtc_tick)
+        sleep_cpu();
 }
 
 static void sys_init()
 {
+    power_init();
     btn_init();
+    DDRB = 0b00000011; //LCD-DC, LCD-RST
     spi_init();
     cli();
     set_sleep_mode(SLEEP_MODE_IDLE);
@@ -118,22 +123,29 @@ struct FRAGMENT {
     uint8_t x, y, val;
 };
 
+//LCD-CE (PB2) low during each frame only
+static const struct SPI_DEV g_lcd_spi = SPI_DEV_INIT(PORTB, PB2, SPI_CLOCK_DIV);
+static uint8_t g_frame[6 * 84];
+
+//the frame is drawn to RAM and sent by the SPI ISR while update() runs
 static void f_main_loop(void* obj, void (*update)(), void (*draw)())
 {
+    struct SPI_XFER x;
     while(btn_get_state(2)) {
         struct FRAGMENT frag;
+        uint8_t* p = g_frame;
         for(frag.y = 0; frag.y < 6; frag.y ++) {
             for(frag.x = 0; frag.x < 84; frag.x ++) {
                 frag.val = 0;
                 draw(obj, &frag);
-                spi_wait_write();
-                spi_write_byte(frag.val);
+                *p ++ = frag.val;
             }
         }
-        spi_wait_write();
+        spi_xfer_write(&x, &g_lcd_spi, g_frame, sizeof(g_frame), 0);
         //        PORTB = 0b000111; //LCD-CE off, LCD-DC high - same power consuption - 1.30ma x 3v
         update(obj);
-        sleep_cpu();
+        rtc_wait();
+        spi_wait(&x);
     } 
     btn_wait_release(2);
 }
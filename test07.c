@@ -5,13 +5,31 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//TODO: the SX1276 takes SCK up to 10 MHz, try 2
+#define SPI_CLOCK_DIV   16
+
+//main loop events, see lib/event.h
+enum { EV_RTC, EV_LORA, EV_UART };
+#define UART_RX_EVENT   EV_UART
+
+//sleep mode chosen per sleep (lib/power.h): idle while the UART receives
+#define POWER_GOVERNOR
+
+#define UART_BAUD 38400UL
+#include "lib/power.h"
+#include "lib/event.h"
+#include "lib/uart.h"
+#include "lib/uart_tx.h"
+#include "lib/print.h"
+#include "lib/lora.h"
+#include "lib/uart_rx.h"
+#include "lib/cmd_line.h"
+#include "lib/cobs.h"
+#include "lib/baud_switch.h"
+
 #define LORA_RST        (1 << PB0)
 #define LORA_RX_TX_DONE (1 << PB1)
 #define LORA_TX_DONE    (1 << PB1)
-#define LORA_NSS        (1 << PB2)
-#define SPI_MOSI        (1 << PB3)
-#define SPI_MISO        (1 << PB4)
-#define SPI_SCK         (1 << PB5)
 
 #define LED_PIN         (1 << PC0)
 
@@ -21,6 +39,8 @@ struct {
     uint8_t padding : 4;
 } static g_flags = {1, 6, 0};
 
+static volatile uint32_t g_rtc_ticks = 0;
+
 /*
 
 static uint8_t lora_init_blob[] = {
@@ -172,6 +192,7 @@ static void led_off()
 
 static void rtc_init()
 {  
+    power_claim(POWER_TIMER2);
     TCCR2A = 0x00;  //overflow
     TCCR2B = 0x03;  //0.25 s
     TIMSK2 = 0x01;  //enable timer2A overflow interrupt
@@ -180,87 +201,27 @@ static void rtc_init()
 
 ISR(TIMER2_OVF_vect)
 {
+    g_rtc_ticks ++;
+    event_post(EV_RTC);
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-static void spi_init()
-{
-    DDRB = LORA_RST | LORA_NSS | SPI_MOSI | SPI_SCK;
-    SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPI2X); //enable SPI-master, clock/2 speed
-    //TODO: Wrong initialzation! Use this for fast SPI:
-    //SPSR = SPI2X; //clk / 2
-    //SPCR = (1 << SPE) | (1 << MSTR);
-    PORTB |= LORA_NSS;
-}
-
-static void spi_chip_enable()
-{
-    PORTB &= ~LORA_NSS;
-}
-
-static void spi_chip_disable()
-{
-    PORTB |= LORA_NSS;
-}
-
-static void spi_wait_write()
+static uint32_t rtc_get_ticks()
 {
-    while(!(SPSR & (1 << SPIF)));
+    cli();
+    uint32_t ticks = g_rtc_ticks;
+    sei();
+    return ticks;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
-
-static void uart_init()
-{
-    UBRR0H = (uint8_t) (USART_UBBR_VALUE >> 8);
-    UBRR0L = (uint8_t) USART_UBBR_VALUE;
-
-    UCSR0A = 0;
-
-    //Enable UART
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0);
-
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-}
-
-static void uart_tx(uint8_t data)
-{
-    UDR0 = data;
-    while (!(UCSR0A & (1 << UDRE0)));
-}
-
-static uint8_t uart_rx()
-{
-    return UDR0;
-}
-
-static void p_str(const char* str)
-{
-    if(!str)
-        return;
-    while(*str) {
-        uart_tx(*str++);
-    }
-}
-
-static void p_line(const char* pp)
-{
-    p_str(pp);
-    p_str("\r\n");
-}
 
-static void p_name_value(const char* name, const char* val, const char* units)
+//name and units in flash
+static void p_name_value(PGM_P name, const char* val, PGM_P units)
 {
-    p_str(name);
-    p_str(" = ");
+    p_str_P(name);
+    p_str_P(PSTR(" = "));
     p_str(val);
-    p_line(units);
+    p_line_P(units);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -277,81 +238,28 @@ static void sys_error()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static void lora_reset_pin()
-{
-    PORTB &= ~LORA_RST;
-    _delay_us(100);
-    PORTB |= LORA_RST;
-    _delay_ms(10);
-}
-
-static uint8_t lora_read_reg(uint8_t reg)
-{
-    spi_chip_enable();
-    SPDR = reg;
-    spi_wait_write();
-    SPDR = 0;
-    spi_wait_write();
-    spi_chip_disable();
-    return SPDR;
-}
-
-static void lora_write_reg(uint8_t reg, uint8_t val)
+//DIO0 (PB1, PCINT1) rising edge: RX or TX done
+static void lora_dio0_init()
 {
-    spi_chip_enable();
-    SPDR = reg | 0x80;
-    spi_wait_write();
-    SPDR = val;
-    spi_wait_write();
-    spi_chip_disable();
+    PCMSK0 |= 1 << PCINT1;
+    PCICR |= 1 << PCIE0;
 }
 
-static void p_hex_digit(uint8_t val)
+ISR(PCINT0_vect)
 {
-    static const uint8_t hex_chars[] = {
-        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
-    };
-    p_str("0x");
-    uart_tx(hex_chars[(val & 0xF0) >> 4]);
-    uart_tx(hex_chars[(val & 0x0F)]);
+    if(PINB & LORA_RX_TX_DONE)
+        event_post(EV_LORA);
 }
 
-static void p_binary(uint8_t val)
-{
-    uint8_t i = 0b10000000;
-    while(i > 0b00001000) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-    uart_tx(' ');
-    while(i) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-}
-
-static void lora_print_reg(uint8_t reg)
-{
-    uint8_t val = lora_read_reg(reg);
-    p_hex_digit(reg);
-    p_str(": ");
-    p_hex_digit(val);
-    p_str(" = ");
-    p_binary(val);
-    p_str("\r\n");
-}
-
-static void lora_update_reg(uint8_t reg, uint8_t mask, uint8_t val)
+static void lora_reset_pin()
 {
-    lora_write_reg(reg, val | (mask & lora_read_reg(reg)));
+    PORTB &= ~LORA_RST;
+    _delay_us(100);
+    PORTB |= LORA_RST;
+    _delay_ms(10);
 }
 
 //RegOpMode (0x01)
-static void lora_set_sleep_mode()
-{
-    lora_write_reg(0x01, 0b10001000);
-}
-
 static void lora_set_standby_mode()
 {
     lora_write_reg(0x01, 0b10001001);
@@ -408,36 +316,12 @@ static void lora_reset_tx_base_address()
     lora_write_reg(0x0E, 0x00);
 }
 
-//RegFifoAddrPtr
-static void lora_set_fifo_buffer_address(uint8_t address)
-{
-    lora_write_reg(0x0D, address);
-}
-
 //RegFifoRxBaseAddr
 static void lora_reset_rx_base_address()
 {
     lora_write_reg(0x0F, 0x00);
 }
 
-//RegFifoRxCurrentAddr
-static uint8_t lora_get_rx_data_address()
-{
-    return lora_read_reg(0x10);
-}
-
-//RegIrqFlags
-static void lora_reset_irq()
-{
-    lora_write_reg(0x12, 0xff);
-}
-
-//RegRxNbBytes
-static uint8_t lora_get_rx_data_len()
-{
-    return lora_read_reg(0x13);
-}
-
 //RegModemConfig1 (0x1D)
 static void lora_set_bw78_cr48_implicit()
 {
@@ -559,23 +443,22 @@ static void lora_init_common()
     lora_set_standby_mode();
 }
 
-static void lora_switch_bw()
+static void lora_set_bw(uint8_t val)
 {
-    uint8_t val = lora_read_reg(0x1D);
-    val >>= 4;
-    val ++;
     if(9 < val)
         val = 0;
     lora_update_reg(0x1D, 0x0F, val << 4);
     lora_print_reg(0x1D);
 }
 
-static void lora_switch_sf()
+static void lora_switch_bw()
+{
+    lora_set_bw((lora_read_reg(0x1D) >> 4) + 1);
+}
+
+static void lora_set_sf(uint8_t val)
 {
-    uint8_t val = lora_read_reg(0x1E);
-    val >>= 4;
-    val ++;
-    if(12 < val) {
+    if(12 < val || 6 >= val) {
         val = 6;
         lora_set_detection_optimize_for_sf_6();
         lora_set_detection_threshold_for_sf_6();
@@ -587,17 +470,22 @@ static void lora_switch_sf()
     lora_print_reg(0x1E);
 }
 
+static void lora_switch_sf()
+{
+    lora_set_sf((lora_read_reg(0x1E) >> 4) + 1);
+}
+
 static void print_led_status()
 {
-    p_str("LED status: ");
-    p_line(g_flags.led_status ? "enabled" : "disabled");
+    p_str_P(PSTR("LED status: "));
+    p_line_P(g_flags.led_status ? PSTR("enabled") : PSTR("disabled"));
 }
 
 static void print_tx_delay()
 {
-    p_str("TX delay: ");
+    p_str_P(PSTR("TX delay: "));
     p_hex_digit(g_flags.tx_delay);
-    p_line("");
+    p_crlf();
 }
 
 static void lora_print_settings()
@@ -615,59 +503,108 @@ static void lora_print_settings()
     print_tx_delay();
 }
 
+#ifdef UART_TX_BENCH
+/*
+CPU time spent in the 'i' command, Timer1 at F_CPU / 64 (8 us per count).
+Build with -DUART_TX_BENCH, and -DUART_TX_POLLED for the busy-wait path.
+*/
+static void bench_print_settings()
+{
+    power_claim(POWER_TIMER1);
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TCCR1B = (1 << CS11) | (1 << CS10);
+    lora_print_settings();
+    uint16_t count = TCNT1;
+    TCCR1B = 0;
+    power_release(POWER_TIMER1);
+    uart_tx_flush();
+    p_str_P(PSTR("Print time, 8 us units: "));
+    p_u16(count);
+    p_crlf();
+}
+#endif
+
+#ifdef EVENT_STATS
+//sleeps and SPI bytes since the last 'e', build with -DEVENT_STATS -DSPI_STATS
+static void print_event_stats()
+{
+    cli();
+    uint16_t sleeps = event_sleeps;
+    event_sleeps = 0;
+    sei();
+    p_str_P(PSTR("Sleeps: "));
+    p_u16(sleeps);
+    p_crlf();
+#ifdef SPI_STATS
+    p_str_P(PSTR("SPI bytes: "));
+    p_u32(spi_transfers);
+    p_crlf();
+    spi_transfers = 0;
+#endif
+}
+#endif
+
 static void show_usage()
 {
-    p_line("Usage:");
-    p_line("i - Display registers");
-    p_line("m - Next mode (RX,TX,SLEEP)");
-    p_line("w - Next BW");
-    p_line("s - Next SF");
-    p_line("l - LED enable/disable");
-    p_line("t - TX delay 0 - 7 log. units");
+    p_line_P(PSTR("Usage, end commands with <ENTER>:"));
+    p_line_P(PSTR("i - Display registers"));
+    p_line_P(PSTR("m - Next mode (RX,TX,SLEEP)"));
+    p_line_P(PSTR("w, bw [0-9] - Next or given BW"));
+    p_line_P(PSTR("s, sf [6-12] - Next or given SF"));
+    p_line_P(PSTR("l - LED enable/disable"));
+    p_line_P(PSTR("t [0-7] - Next or given TX delay, log. units"));
+    p_line_P(PSTR("r [0-0x7f] - Display register"));
+    p_line_P(PSTR("baud N - Switch to N * 100 baud, see client -u"));
+#ifdef EVENT_STATS
+    p_line_P(PSTR("e - Sleeps and SPI bytes since the last e"));
+#endif
 }
 
 static void lora_init_rx()
 {
-    p_line("RX");
+    p_line_P(PSTR("RX"));
     lora_map_rx_to_dio0();
     lora_set_fifo_buffer_address(0x00);
     lora_set_rx_cont_mode();
 }
 
-static void lora_read_fifo_32_bytes(uint8_t buff[32])
-{
-    uint8_t* pp = buff;
-    uint8_t count = 32;
-    lora_set_fifo_buffer_address(lora_get_rx_data_address());
-    spi_chip_enable();
-    SPDR = 0;
-    spi_wait_write();
-    while(count--) {
-        SPDR = 0;
-        spi_wait_write();
-        *pp++ = SPDR;
-    }
-    spi_chip_disable();
+//Radio packet record for client.c, a lib/cobs.h frame:
+//RADIO_FUNC, 0, payload[len], RegPktRssiValue, RegPktSnrValue, RTC ticks (LE)
+#define RX_RECORD_MAX   32
+
+static void p_rx_record(const uint8_t* data, uint8_t len, uint8_t rssi, int8_t snr)
+{
+    uint8_t rec[2 + RX_RECORD_MAX + 6];
+    uint8_t frame[COBS_FRAME_LEN(sizeof(rec))];
+    uint32_t ts = rtc_get_ticks();
+    uint8_t* pp = rec;
+    if(len > RX_RECORD_MAX)
+        len = RX_RECORD_MAX;
+    *pp++ = RADIO_FUNC;
+    *pp++ = 0;
+    while(len--)
+        *pp++ = *data++;
+    *pp++ = rssi;
+    *pp++ = snr;
+    *pp++ = ts;
+    *pp++ = ts >> 8;
+    *pp++ = ts >> 16;
+    *pp++ = ts >> 24;
+    uint8_t frame_len = cobs_frame(frame, rec, pp - rec);
+    for(uint8_t i = 0; i < frame_len; i ++)
+        uart_tx(frame[i]);
 }
 
 static void lora_read_rx_data()
 {
-    lora_set_fifo_buffer_address(lora_get_rx_data_address());
-    'L' == lora_read_reg(0x00) ? led_on() : led_off();
-}
-
-static void lora_write_fifo_32_bytes(const uint8_t data[32])
-{
-    const uint8_t* pp = data;
-    uint8_t count = 32;
-    spi_chip_enable();
-    SPDR = 0x80;
-    spi_wait_write();
-    while(count--) {
-        SPDR = *pp++;
-        spi_wait_write();
-    }
-    spi_chip_disable();
+    uint8_t buff[RX_RECORD_MAX];
+    uint8_t len = lora_get_rx_data_len();
+    if(len > sizeof(buff))
+        len = sizeof(buff);
+    lora_read_fifo(buff, len);
+    len && 'L' == buff[0] ? led_on() : led_off();
+    p_rx_record(buff, len, lora_get_pkt_rssi(), lora_get_pkt_snr());
 }
 
 static void f_prepare_send_data()
@@ -685,12 +622,12 @@ static void lora_send_tx_data()
 static void lora_init_sleep()
 {
     lora_set_sleep_mode();
-    p_line("SLEEP");
+    p_line_P(PSTR("SLEEP"));
 }
 
 static void lora_init_tx()
 {
-    p_line("TX");
+    p_line_P(PSTR("TX"));
     lora_map_tx_to_dio0();
     lora_send_tx_data();
 }
@@ -707,26 +644,67 @@ static void switch_tx_delay()
     print_tx_delay();
 }
 
-static void f_uart(uint8_t* state)
+static void set_tx_delay(uint8_t val)
 {
-    if(!(UCSR0A & (1 << RXC0)))
-        return;
-    uint8_t ch = uart_rx();
-    if('i' == ch)
-        return lora_print_settings();
-    if('m' == ch) {
+    g_flags.tx_delay = val;
+    print_tx_delay();
+}
+
+static struct CMD_LINE g_cmd;
+
+//no argument, or one in min..max: the ranges of show_usage()
+static uint8_t cmd_arg_ok(const struct CMD_LINE* cl, uint8_t min, uint8_t max)
+{
+    return !cl->argc || (cl->argv[0] >= min && cl->argv[0] <= max);
+}
+
+//returns 1 for an unknown command; an argument out of range gets the usage
+//instead of a truncated value
+static uint8_t f_uart_cmd(uint8_t* state)
+{
+    const struct CMD_LINE* cl = &g_cmd;
+    uint8_t arg = cl->argv[0];
+    if(cmd_line_is_P(cl, PSTR("i")))
+#ifdef UART_TX_BENCH
+        bench_print_settings();
+#else
+        lora_print_settings();
+#endif
+    else if(cmd_line_is_P(cl, PSTR("m")))
         ++(*state);
-        return;
+    else if((cmd_line_is_P(cl, PSTR("w")) || cmd_line_is_P(cl, PSTR("bw"))) && cmd_arg_ok(cl, 0, 9))
+        cl->argc ? lora_set_bw(arg) : lora_switch_bw();
+    else if((cmd_line_is_P(cl, PSTR("s")) || cmd_line_is_P(cl, PSTR("sf"))) && cmd_arg_ok(cl, 6, 12))
+        cl->argc ? lora_set_sf(arg) : lora_switch_sf();
+    else if(cmd_line_is_P(cl, PSTR("l")))
+        led_toggle_status();
+    else if(cmd_line_is_P(cl, PSTR("t")) && cmd_arg_ok(cl, 0, 7))
+        cl->argc ? set_tx_delay(arg) : switch_tx_delay();
+    //bit 7 of the SPI address byte is the write flag
+    else if(cmd_line_is_P(cl, PSTR("r")) && cl->argc && cmd_arg_ok(cl, 0, 0x7F))
+        lora_print_reg(arg);
+    else if(cmd_line_is_P(cl, PSTR("baud")) && cl->argc)
+        baud_switch(cl->argv[0]);
+#ifdef EVENT_STATS
+    else if(cmd_line_is_P(cl, PSTR("e")))
+        print_event_stats();
+#endif
+    else
+        return 1;
+    return 0;
+}
+
+//handles everything received since the last wakeup, stops after a mode change
+static void f_uart(uint8_t* state)
+{
+    uint8_t ch;
+    while(!*state && uart_rx_read(&ch)) {
+        uint8_t res = cmd_line_feed(&g_cmd, ch);
+        if(CMD_LINE_NONE == res)
+            continue;
+        if(CMD_LINE_ERROR == res || f_uart_cmd(state))
+            show_usage();
     }
-    if('w' == ch)
-        return lora_switch_bw();
-    if('s' == ch)
-        return lora_switch_sf();
-    if('l' == ch)
-        return led_toggle_status();
-    if('t' == ch)
-        return switch_tx_delay();
-    show_usage();
 }
 
 static uint8_t lora_check_rx_done()
@@ -739,13 +717,22 @@ static uint8_t lora_check_tx_done()
     return !!(0b0001000 & lora_read_reg(0x12));
 }
 
+//a loop starts with DIO0 and the commands left by the previous loop checked once
+static void f_loop_start()
+{
+    event_clear(EVENT_MASK(EV_RTC));
+    event_post(EV_LORA);
+    event_post(EV_UART);
+}
+
 static void f_sleep_loop()
 {
     uint8_t run = 0;
     lora_init_sleep();
     led_off();
+    f_loop_start();
     while(!run) {
-        sleep_cpu();
+        event_wait(EVENT_MASK(EV_UART));
         f_uart(&run);
     }
 }
@@ -763,9 +750,7 @@ static void f_tx_lora(uint8_t* count)
 
 static void f_tx_rtc(uint8_t* count)
 {
-    if(!*count)
-        return;
-    if(!--(*count))
+    if(*count && !--(*count))
         lora_send_tx_data();
 }
 
@@ -774,19 +759,18 @@ static void f_tx_loop()
     uint8_t run = 0;
     uint8_t count = 1;
     lora_init_tx();
+    f_loop_start();
     while(!run) {
-        sleep_cpu();
-        f_tx_rtc(&count);
-        f_tx_lora(&count);
-        f_uart(&run);
+        uint8_t ev = event_wait(EVENT_MASK(EV_RTC) | EVENT_MASK(EV_LORA) | EVENT_MASK(EV_UART));
+        if(ev & EVENT_MASK(EV_RTC))
+            f_tx_rtc(&count);
+        if(ev & EVENT_MASK(EV_LORA))
+            f_tx_lora(&count);
+        if(ev & EVENT_MASK(EV_UART))
+            f_uart(&run);
     }
 }
 
-static void f_rx_rtc()
-{
-    led_off();
-}
-
 static void f_rx_lora()
 {
     if(!(PINB & LORA_RX_TX_DONE))
@@ -801,21 +785,28 @@ static void f_rx_loop()
 {
     uint8_t run = 0;
     lora_init_rx();
+    f_loop_start();
     while(!run) {
-        sleep_cpu();
-        f_rx_rtc();
-        f_rx_lora();
-        f_uart(&run);
+        uint8_t ev = event_wait(EVENT_MASK(EV_RTC) | EVENT_MASK(EV_LORA) | EVENT_MASK(EV_UART));
+        if(ev & EVENT_MASK(EV_RTC))
+            led_off();
+        if(ev & EVENT_MASK(EV_LORA))
+            f_rx_lora();
+        if(ev & EVENT_MASK(EV_UART))
+            f_uart(&run);
     }
 }
 
 static void sys_init()
 {
     cli();
+    power_init();
     set_sleep_mode(SLEEP_MODE_IDLE);
     sleep_enable();
-    uart_init();
+    uart_init(1);
+    DDRB = LORA_RST;
     spi_init();
+    lora_dio0_init();
     led_init();
     rtc_init();
     sei();
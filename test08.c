@@ -5,19 +5,27 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//TODO: the SX1276 takes SCK up to 10 MHz, try 2
+#define SPI_CLOCK_DIV   16
+
+//power-save between the RTC ticks once the UART is done, see lib/power.h
+#define POWER_GOVERNOR
+
+#define UART_BAUD 38400UL
+#include "lib/power.h"
+#include "lib/uart.h"
+#include "lib/uart_tx.h"
+#include "lib/print.h"
+#include "lib/lora.h"
+
 #define LORA_RST        (1 << PB0)
 #define LORA_RX_TX_DONE (1 << PB1)
 #define LORA_TX_DONE    (1 << PB1)
-#define LORA_NSS        (1 << PB2)
-#define SPI_MOSI        (1 << PB3)
-#define SPI_MISO        (1 << PB4)
-#define SPI_SCK         (1 << PB5)
 
 /*
 
 TODO:
-1. Decrease power consumption using PRR register
-2. Use TX Done interrupt
+1. Use TX Done interrupt
 
 Atmega328p Vcc ADC:
 https://arduino.stackexchange.com/questions/23526/measure-different-vcc-using-1-1v-bandgap
@@ -60,90 +68,41 @@ https://revspace.nl/DecodingLora
 
 static void rtc_init()
 {  
+    power_claim(POWER_TIMER2);
     TCCR2A = 0x00;  //overflow
     TCCR2B = 0x05;  //1 s
     TIMSK2 = 0x01;  //enable timer2A overflow interrupt
     ASSR  = 0x20;   //enable asynchronous mode
 }
 
-ISR(TIMER2_OVF_vect)
-{
-}
-
-///////////////////////////////////////////////////////////////////////////////
+static volatile uint8_t g_rtc_tick = 0;
 
-static void spi_init()
-{
-    DDRB = LORA_RST | LORA_NSS | SPI_MOSI | SPI_SCK;
-    SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPI2X); //enable SPI-master, clock/2 speed
-    //TODO: Wrong initialzation! Use this for fast SPI:
-    //SPSR = SPI2X; //clk / 2
-    //SPCR = (1 << SPE) | (1 << MSTR);
-    PORTB |= LORA_NSS;
-}
-
-static void spi_chip_enable()
-{
-    PORTB &= ~LORA_NSS;
-}
-
-static void spi_chip_disable()
-{
-    PORTB |= LORA_NSS;
-}
-
-static void spi_wait_write()
-{
-    while(!(SPSR & (1 << SPIF)));
-}
-
-///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
-
-static void uart_init()
-{
-    UBRR0H = (uint8_t) (USART_UBBR_VALUE >> 8);
-    UBRR0L = (uint8_t) USART_UBBR_VALUE;
-
-    UCSR0A = 0;
-
-    //Enable UART
-    UCSR0B = (1 << TXEN0);
-
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-}
-
-static void uart_tx(uint8_t data)
+ISR(TIMER2_OVF_vect)
 {
-    UDR0 = data;
-    while (!(UCSR0A & (1 << UDRE0)));
+    g_rtc_tick = 1;
 }
 
-static void p_str(const char* str)
+//sleep until the next RTC overflow, the UART wakes the CPU as well
+static void rtc_sleep()
 {
-    if(!str)
-        return;
-    while(*str) {
-        uart_tx(*str++);
+    cli();
+    g_rtc_tick = 0;
+    while(!g_rtc_tick) {
+        power_sleep();
+        cli();
     }
+    sei();
 }
 
-static void p_line(const char* pp)
-{
-    p_str(pp);
-    p_str("\r\n");
-}
+///////////////////////////////////////////////////////////////////////////////
 
-static void p_name_value(const char* name, const char* val, const char* units)
+//name and units in flash
+static void p_name_value(PGM_P name, const char* val, PGM_P units)
 {
-    p_str(name);
-    p_str(" = ");
+    p_str_P(name);
+    p_str_P(PSTR(" = "));
     p_str(val);
-    p_line(units);
+    p_line_P(units);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -155,72 +114,10 @@ static void lora_reset_pin()
     PORTB |= LORA_RST;
 }
 
-static uint8_t lora_read_reg(uint8_t reg)
-{
-    spi_chip_enable();
-    SPDR = reg;
-    spi_wait_write();
-    SPDR = 0;
-    spi_wait_write();
-    spi_chip_disable();
-    return SPDR;
-}
-
-static void lora_write_reg(uint8_t reg, uint8_t val)
-{
-    spi_chip_enable();
-    SPDR = reg | 0x80;
-    spi_wait_write();
-    SPDR = val;
-    spi_wait_write();
-    spi_chip_disable();
-}
-
-static void p_hex_digit(uint8_t val)
-{
-    static const uint8_t hex_chars[] = {
-        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
-    };
-    p_str("0x");
-    uart_tx(hex_chars[(val & 0xF0) >> 4]);
-    uart_tx(hex_chars[(val & 0x0F)]);
-}
-
-static void p_binary(uint8_t val)
-{
-    uint8_t i = 0b10000000;
-    while(i > 0b00001000) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-    uart_tx(' ');
-    while(i) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-}
-
-static void lora_print_reg(uint8_t reg)
-{
-    uint8_t val = lora_read_reg(reg);
-    p_hex_digit(reg);
-    p_str(": ");
-    p_hex_digit(val);
-    p_str(" = ");
-    p_binary(val);
-    p_str("\r\n");
-}
-
-//RegOpMode (0x01)
-static void lora_set_sleep_mode()
-{
-    lora_write_reg(0x01, 0b10001000);
-}
-
 static void lora_init_tx()
 {
     lora_reset_pin();
-    static const uint8_t lora_tx_init_blob[] = {
+    static const uint8_t lora_tx_init_blob[] PROGMEM = {
         0x01, 0b10001000 //Sleep Mode
             , 0x06, 0x6C //MSB 433920000 Hz
             , 0x07, 0x7A //Mid
@@ -244,8 +141,9 @@ static void lora_init_tx()
             , 0xFF, 0xFF //end
     };
     const uint8_t* pp = lora_tx_init_blob;
-    while(0xFF != *pp) {
-        lora_write_reg(pp[0], pp[1]);
+    uint8_t reg;
+    while(0xFF != (reg = pgm_read_byte(pp))) {
+        lora_write_reg(reg, pgm_read_byte(pp + 1));
         pp+=2;
     }
 }
@@ -270,6 +168,7 @@ static uint8_t lora_check_tx_done()
 
 static void adc_read_vcc()
 {
+    power_claim(POWER_ADC);
     ADMUX = 0b01001110; 
     ADCSRA = 0b11000111;
     while(ADCSRA & 0b01000000);
@@ -281,20 +180,21 @@ static void adc_read_vcc()
     p_hex_digit(ADCH);
     ADMUX = 0b00001111;
     ADCSRA = 0b00000111;
-    p_line("");
+    power_release(POWER_ADC);
+    p_crlf();
 }
 
 static void f_tx()
 {
     lora_init_tx();
-    p_line("TX");
+    p_line_P(PSTR("TX"));
     adc_read_vcc();
 //    lora_print_settings();
     while(!(PINB & LORA_RX_TX_DONE) || !lora_check_tx_done()) {
-        p_line("TX Check");
-        sleep_cpu();
+        p_line_P(PSTR("TX Check"));
+        rtc_sleep();
     }
-    p_line("TX Done");
+    p_line_P(PSTR("TX Done"));
     lora_set_sleep_mode();
     adc_read_vcc();
 }
@@ -303,16 +203,19 @@ static void f_pause()
 {
     uint16_t count = 1;
     while(count --) {
-        sleep_cpu();
+        rtc_sleep();
     }
 }
 
 static void sys_init()
 {
     cli();
+    //TWI, Timer0, Timer1 and the ADC between measurements stay gated
+    power_init();
     set_sleep_mode(SLEEP_MODE_IDLE);
     sleep_enable();
-    uart_init();
+    uart_init(0);
+    DDRB = LORA_RST;
     spi_init();
     rtc_init();
     sei();
@@ -5,16 +5,36 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//TODO: the SX1276 takes SCK up to 10 MHz, try 2
+#define SPI_CLOCK_DIV   16
+
+//main loop events, see lib/event.h
+enum { EV_LORA, EV_UART };
+#define UART_RX_EVENT   EV_UART
+
+//sleep mode chosen per sleep (lib/power.h): the UART and the trace Timer1 keep it idle
+#define POWER_GOVERNOR
+
+#define UART_BAUD 38400UL
+#include "lib/power.h"
+#include "lib/event.h"
+#include "lib/uart.h"
+#include "lib/uart_tx.h"
+#include "lib/uart_rx.h"
+#include "lib/print.h"
+#include "lib/lora.h"
+#include "lib/cmd_line.h"
+#include "lib/cobs.h"
+#include "lib/trace.h"
+
 #define LORA_RST        (1 << PB0)
 #define LORA_RX_TX_DONE (1 << PB1)
 #define LORA_TX_DONE    (1 << PB1)
-#define LORA_NSS        (1 << PB2)
-#define SPI_MOSI        (1 << PB3)
-#define SPI_MISO        (1 << PB4)
-#define SPI_SCK         (1 << PB5)
 
 #define LED_PIN         (1 << PC0)
 
+static volatile uint32_t g_rtc_ticks = 0;
+
 /*
    ATMEGA328 + LoRa RA01 receive mode
    ATMEGA 328P:
@@ -30,6 +50,7 @@ PB4 -- MISO
 PB5 -- SCK
 
 Interrupts: RTC (timer 2 overflow), UART RX, pin change PB1
+Timer1: trace timestamps, "d <ENTER>" dumps the trace
 !! PB2 -- 100K -- VCC (disable loRa during ASP programming)
 
 SX1276/77/78/79 datasheet:
@@ -58,6 +79,7 @@ static void led_off()
 
 static void rtc_init()
 {  
+    power_claim(POWER_TIMER2);
     TCCR2A = 0x00;  //overflow
     TCCR2B = 0x05;  //1 s
     TIMSK2 = 0x01;  //enable timer2A overflow interrupt
@@ -66,86 +88,43 @@ static void rtc_init()
 
 ISR(TIMER2_OVF_vect)
 {
+    g_rtc_ticks ++;
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-static void spi_init()
-{
-    DDRB = LORA_RST | LORA_NSS | SPI_MOSI | SPI_SCK;
-    SPCR = (1 << SPE) | (1 << MSTR) | (1 << SPI2X); //enable SPI-master, clock/2 speed
-    //TODO: Wrong initialzation! Use this for fast SPI:
-    //SPSR = SPI2X; //clk / 2
-    //SPCR = (1 << SPE) | (1 << MSTR);
-    PORTB |= LORA_NSS;
-}
-
-static void spi_chip_enable()
+static uint32_t rtc_get_ticks()
 {
-    PORTB &= ~LORA_NSS;
-}
-
-static void spi_chip_disable()
-{
-    PORTB |= LORA_NSS;
-}
-
-static void spi_wait_write()
-{
-    while(!(SPSR & (1 << SPIF)));
+    cli();
+    uint32_t ticks = g_rtc_ticks;
+    sei();
+    return ticks;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-///////////////////////////////////////////////////////////////////////////////
-
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
-
-static void uart_init()
-{
-    UBRR0H = (uint8_t) (USART_UBBR_VALUE >> 8);
-    UBRR0L = (uint8_t) USART_UBBR_VALUE;
-
-    UCSR0A = 0;
-
-    //Enable UART
-    UCSR0B = (1 << TXEN0);
-
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-}
 
-static void uart_tx(uint8_t data)
+//name and units in flash
+static void p_name_value(PGM_P name, const char* val, PGM_P units)
 {
-    UDR0 = data;
-    while (!(UCSR0A & (1 << UDRE0)));
+    p_str_P(name);
+    p_str_P(PSTR(" = "));
+    p_str(val);
+    p_line_P(units);
 }
 
-static void p_str(const char* str)
-{
-    if(!str)
-        return;
-    while(*str) {
-        uart_tx(*str++);
-    }
-}
+///////////////////////////////////////////////////////////////////////////////
 
-static void p_line(const char* pp)
+//DIO0 (PB1, PCINT1) rising edge: RX done
+static void lora_dio0_init()
 {
-    p_str(pp);
-    p_str("\r\n");
+    PCMSK0 |= 1 << PCINT1;
+    PCICR |= 1 << PCIE0;
 }
 
-static void p_name_value(const char* name, const char* val, const char* units)
+ISR(PCINT0_vect)
 {
-    p_str(name);
-    p_str(" = ");
-    p_str(val);
-    p_line(units);
+    if(PINB & LORA_RX_TX_DONE)
+        event_post(EV_LORA);
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
 static void lora_reset_pin()
 {
     PORTB &= ~LORA_RST;
@@ -153,72 +132,10 @@ static void lora_reset_pin()
     PORTB |= LORA_RST;
 }
 
-static uint8_t lora_read_reg(uint8_t reg)
-{
-    spi_chip_enable();
-    SPDR = reg;
-    spi_wait_write();
-    SPDR = 0;
-    spi_wait_write();
-    spi_chip_disable();
-    return SPDR;
-}
-
-static void lora_write_reg(uint8_t reg, uint8_t val)
-{
-    spi_chip_enable();
-    SPDR = reg | 0x80;
-    spi_wait_write();
-    SPDR = val;
-    spi_wait_write();
-    spi_chip_disable();
-}
-
-static void p_hex_digit(uint8_t val)
-{
-    static const uint8_t hex_chars[] = {
-        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
-    };
-    p_str("0x");
-    uart_tx(hex_chars[(val & 0xF0) >> 4]);
-    uart_tx(hex_chars[(val & 0x0F)]);
-}
-
-static void p_binary(uint8_t val)
-{
-    uint8_t i = 0b10000000;
-    while(i > 0b00001000) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-    uart_tx(' ');
-    while(i) {
-        uart_tx(val & i ? '1' : '0');
-        i >>= 1;
-    }
-}
-
-static void lora_print_reg(uint8_t reg)
-{
-    uint8_t val = lora_read_reg(reg);
-    p_hex_digit(reg);
-    p_str(": ");
-    p_hex_digit(val);
-    p_str(" = ");
-    p_binary(val);
-    p_str("\r\n");
-}
-
-//RegOpMode (0x01)
-static void lora_set_sleep_mode()
-{
-    lora_write_reg(0x01, 0b10001000);
-}
-
 static void lora_init_rx()
 {
     lora_reset_pin();
-    static const uint8_t lora_init_blob[] = {
+    static const uint8_t lora_init_blob[] PROGMEM = {
         0x01, 0x88 //Sleep Mode
             , 0x06, 0x6c //MSB 433920000 Hz
             , 0x07, 0x7a //Mid.
@@ -242,8 +159,9 @@ static void lora_init_rx()
             , 0xFF, 0xFF //END
     };
     const uint8_t* pp = lora_init_blob;
-    while(0xFF != *pp) {
-        lora_write_reg(pp[0], pp[1]);
+    uint8_t reg;
+    while(0xFF != (reg = pgm_read_byte(pp))) {
+        lora_write_reg(reg, pgm_read_byte(pp + 1));
         pp+=2;
     }
 }
@@ -266,48 +184,100 @@ static uint8_t lora_check_rx_done()
     return !!(0b1000000 & lora_read_reg(0x12));
 }
 
-static void lora_set_fifo_buffer_address(uint8_t address)
+//Radio packet record for client.c, a lib/cobs.h frame:
+//RADIO_FUNC, 0, payload[len], RegPktRssiValue, RegPktSnrValue, RTC ticks (LE)
+#define RX_RECORD_MAX   32
+
+static void p_rx_record(const uint8_t* data, uint8_t len, uint8_t rssi, int8_t snr)
 {
-    lora_write_reg(0x0D, address);
+    uint8_t rec[2 + RX_RECORD_MAX + 6];
+    uint8_t frame[COBS_FRAME_LEN(sizeof(rec))];
+    uint32_t ts = rtc_get_ticks();
+    uint8_t* pp = rec;
+    if(len > RX_RECORD_MAX)
+        len = RX_RECORD_MAX;
+    *pp++ = RADIO_FUNC;
+    *pp++ = 0;
+    while(len--)
+        *pp++ = *data++;
+    *pp++ = rssi;
+    *pp++ = snr;
+    *pp++ = ts;
+    *pp++ = ts >> 8;
+    *pp++ = ts >> 16;
+    *pp++ = ts >> 24;
+    uint8_t frame_len = cobs_frame(frame, rec, pp - rec);
+    for(uint8_t i = 0; i < frame_len; i ++)
+        uart_tx(frame[i]);
 }
 
 static void lora_read_rx_data()
 {
-    uint8_t data = lora_read_reg(0x00);
-    
-    'L' == data ? p_line("L") : p_line(":(");
+    uint8_t buff[RX_RECORD_MAX];
+    uint8_t len = lora_get_rx_data_len();
+    if(len > sizeof(buff))
+        len = sizeof(buff);
+    trace(TRACE_RX_READ, len);
+    lora_read_fifo(buff, len);
+    p_rx_record(buff, len, lora_get_pkt_rssi(), lora_get_pkt_snr());
 }
 
-//RegIrqFlags
-static void lora_reset_irq()
+static struct CMD_LINE g_cmd;
+
+//"d" - dump the trace
+static void f_uart()
 {
-    lora_write_reg(0x12, 0xff);
+    uint8_t ch;
+    while(uart_rx_read(&ch)) {
+        if(CMD_LINE_READY != cmd_line_feed(&g_cmd, ch))
+            continue;
+        trace(TRACE_CMD, g_cmd.buff[0]);
+        if(cmd_line_is_P(&g_cmd, PSTR("d")))
+            trace_dump();
+    }
+}
+
+static void f_rx_lora()
+{
+    uint8_t dio0 = PINB & LORA_RX_TX_DONE;
+    trace(TRACE_RX_CHECK, dio0);
+    if(!dio0 || !lora_check_rx_done())
+        return;
+    trace(TRACE_RX_DONE, 0);
+    lora_reset_irq();
+    lora_read_rx_data();
 }
 
+//the RTC wakes the CPU for the timestamps only, RegIrqFlags is read on DIO0
 static void f_rx()
 {
     lora_init_rx();
     lora_print_settings();
+    event_post(EV_LORA);
     while(1) {
-        while(!(PINB & LORA_RX_TX_DONE) || !lora_check_rx_done()) {
-            p_line("RX Check");
-            sleep_cpu();
-        }
-        p_line("RX Done");
-        lora_reset_irq();
-        lora_read_rx_data();
+        trace(TRACE_SLEEP, 0);
+        uint8_t ev = event_wait(EVENT_MASK(EV_LORA) | EVENT_MASK(EV_UART));
+        trace(TRACE_WAKE, g_rtc_ticks);
+        if(ev & EVENT_MASK(EV_LORA))
+            f_rx_lora();
+        if(ev & EVENT_MASK(EV_UART))
+            f_uart();
     }
 }
 
 static void sys_init()
 {
     cli();
+    power_init();
     set_sleep_mode(SLEEP_MODE_IDLE);
     sleep_enable();
-    uart_init();
+    uart_init(1);
+    DDRB = LORA_RST;
     spi_init();
+    lora_dio0_init();
     led_init();
     rtc_init();
+    trace_init();
     sei();
 }
 
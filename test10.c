@@ -6,6 +6,9 @@
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+#include "lib/power.h"
+#include "lib/fixed.h"
+
 /*
     ATMEGA328P
     7   +
@@ -46,6 +49,8 @@ static void btn_wait_release()
 
 static void pwm_init()
 {
+    power_claim(POWER_TIMER0);
+    power_claim(POWER_TIMER2);
     DDRD |= _BV(PD6) | _BV(PD5) | _BV(PD3);
     DDRB |= _BV(PB3);
 
@@ -76,31 +81,37 @@ static void sys_sleep()
     pwm_enable();
 }
 
+//oscillators in Q16.16 (lib/fixed.h)
 static void effect_0()
 {
-    static float s[8] = {0, 0, 0, 0, 0, 0, 0, 0};
-    static float c[8] = {30, 30, 30, 30, 30, 30, 30, 30};
-    const float f[8] = {0.01, 0.0099, 0.0097, 0.0094, 0.0099, 0.0098, 0.0096, 0.0093};
+    static int32_t s[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    static int32_t c[8] = {
+        Q16_16(30), Q16_16(30), Q16_16(30), Q16_16(30), Q16_16(30), Q16_16(30), Q16_16(30), Q16_16(30)
+    };
+    const int32_t f[8] = {
+        Q16_16(0.01), Q16_16(0.0099), Q16_16(0.0097), Q16_16(0.0094),
+        Q16_16(0.0099), Q16_16(0.0098), Q16_16(0.0096), Q16_16(0.0093)
+    };
 
     while(btn_get_state()) {
         for(uint8_t i = 0; i < sizeof(s) / sizeof(s[0]); i ++) {
 
-            c[i] -= s[i] * f[i];
-            s[i] += c[i] * f[i];
+            c[i] -= q16_mul(s[i], f[i]);
+            s[i] += q16_mul(c[i], f[i]);
         }
 
-        OCR0A = s[0] + s[1] + s[2] + s[3] + 120;
-        OCR0B = c[0] + c[1] + c[2] + c[3] + 120;
-        OCR2A = s[4] + s[5] + s[6] + s[7] + 120;
-        OCR2B = c[4] + c[5] + c[6] + c[7] + 120;
+        OCR0A = q16_int(s[0] + s[1] + s[2] + s[3]) + 120;
+        OCR0B = q16_int(c[0] + c[1] + c[2] + c[3]) + 120;
+        OCR2A = q16_int(s[4] + s[5] + s[6] + s[7]) + 120;
+        OCR2B = q16_int(c[4] + c[5] + c[6] + c[7]) + 120;
     }
     btn_wait_release();
 }
 
 static void effect_1()
 {
-    float s[4] = {0, 0, 0, 0};
-    float c[4] = {0, 0, 0, 0};
+    int32_t s[4] = {0, 0, 0, 0};
+    int32_t c[4] = {0, 0, 0, 0};
     uint8_t r0 = 0;
     uint8_t r = 0;
 
@@ -113,23 +124,24 @@ static void effect_1()
         r0 = r;
 
         s[r] = 0;
-        c[r] = 15;
+        c[r] = Q16_16(15);
 
         for(uint16_t i = 0; btn_get_state() && i < 9000; i ++) {
             for(uint8_t j = 0; j < sizeof(s) / sizeof(s[0]); j ++) {
-                c[j] -= s[j] * 0.002;
-                s[j] += c[j] * 0.002;
-                s[j] += (0 - s[j]) * 0.0003;
+                c[j] -= q16_mul(s[j], Q16_16(0.002));
+                s[j] += q16_mul(c[j], Q16_16(0.002));
+                s[j] -= q16_mul(s[j], Q16_16(0.0003));
             }
-            OCR0A = (uint8_t)(s[0] * s[0] + 2);
-            OCR0B = (uint8_t)(s[1] * s[1] + 2);
-            OCR2A = (uint8_t)(s[2] * s[2] + 2);
-            OCR2B = (uint8_t)(s[3] * s[3] + 2);
+            OCR0A = (uint8_t)q16_int(q16_mul(s[0], s[0]) + Q16_16(2));
+            OCR0B = (uint8_t)q16_int(q16_mul(s[1], s[1]) + Q16_16(2));
+            OCR2A = (uint8_t)q16_int(q16_mul(s[2], s[2]) + Q16_16(2));
+            OCR2B = (uint8_t)q16_int(q16_mul(s[3], s[3]) + Q16_16(2));
         }
     }
     btn_wait_release();
 }
 
+//float: f grows by 1.0002 a step from 0.001, less than a Q16.16 step
 static void effect_2()
 {
     float s[4] = {0, 0, 0, 0};
@@ -173,6 +185,7 @@ int main(void) {
 
     PORTC |= _BV(PC6);
 
+    power_init();
     pwm_init();
     btn_init();
 
@@ -3,11 +3,28 @@
 #include <avr/sleep.h>
 #include <avr/wdt.h>
 #include <util/twi.h>
-#include <stdio.h>
 
 #define F_CPU 8000000UL
 #include <util/delay.h>
 
+//main loop events, see lib/event.h
+enum { EV_WDT, EV_UART };
+#define UART_RX_EVENT   EV_UART
+
+//each sleep in the deepest mode the peripherals allow, see lib/power.h
+#define POWER_GOVERNOR
+
+#define UART_BAUD 38400UL
+#include "lib/power.h"
+#include "lib/event.h"
+#include "lib/uart.h"
+#include "lib/print.h"
+#include "lib/uart_rx.h"
+#include "lib/spi.h"
+#include "lib/twi_async.h"
+#include "lib/fixed.h"
+#include "lib/clock.h"
+
 /*
 Non-arduino and arduino code example for NRF24L01_PA_LNA
 http://www.hotmcu.com/wiki/NRF24L01_PA_LNA_Wireless_Module
@@ -33,71 +50,15 @@ https://embedds.com/programming-avr-i2c-interface/
     Loop 3.3V: 8Mhz-3.74ma, 1Mhz-0.74ma, 128Kh-0.21ma, 31Khz-0.15ma
 */
 
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
-
-static void uart_init() {
-    UBRR0 = USART_UBBR_VALUE;
-    UCSR0A = 0;
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
-}
-
-ISR(USART_RX_vect)
-{
-}
-
-static int uart_print_char(char ch, FILE* pf)
-{
-    while (!(UCSR0A & (1 << UDRE0)));
-    UDR0 = ch;
-    return 0;
-}
-
-static FILE uart_str = {
-    .put = uart_print_char,
-    .flags = _FDEV_SETUP_WRITE
-};
-
-static void spi_chip_enable()
-{
-    PORTB &= ~0b100;
-}
-
-static void spi_chip_disable()
-{
-    PORTB |= 0b100;
-}
-
-static void spi_init()
-{
-    DDRB = 0b101101;
-    spi_chip_disable();
-    SPSR = SPI2X; //clk / 2
-    SPCR = (1 << SPE) | (1 << MSTR);
-}
-
-static void spi_wait_write()
-{
-    while(!(SPSR & (1 << SPIF)));
-}
-
-static uint8_t spi_read_reg(uint8_t reg)
-{
-    spi_chip_enable();
-    SPDR = reg;
-    spi_wait_write();
-    SPDR = 0;
-    spi_wait_write();
-    spi_chip_disable();
-    return SPDR;
-}
 
 static void spi_print_reg(uint8_t reg)
 {
     uint8_t val = spi_read_reg(reg);
-    fprintf(&uart_str, "REG %02X=%02X\r\n", reg, val);
+    p_str_P(PSTR("REG "));
+    p_hex8(reg);
+    p_char('=');
+    p_hex8(val);
+    p_crlf();
 }
 
 static void gpio_enable_reset_pullup()
@@ -114,29 +75,41 @@ static void wdt_set_2s()
 ISR(WDT_vect)
 {
     wdt_set_2s();
+    event_post(EV_WDT);
 //    fprintf(&uart_str, "WDT event\r\n");
 }
 
-static void cpu_clock_div_set(uint8_t num)
+//sleep until the watchdog or a key press, the UART TX interrupt wakes the CPU as well;
+//the waits run at CLOCK_SLOW_DIV, the work between them at F_CPU (lib/clock.h).
+//Console input wins over the current: a switch waits for a byte seen on RXD,
+//and keys not read yet keep F_CPU through the wait, so the two switches of a
+//typed-ahead key are skipped. Pasted text can still lose a byte at a switch
+static void sys_sleep()
 {
-    cli();
-    CLKPR = 0b10000000;
-    CLKPR = num & 0b00001111;
-    sei();
+    clock_release();
+    event_clear(EVENT_MASK(EV_WDT) | EVENT_MASK(EV_UART));
+    while(!uart_rx_available()
+            && !(event_wait(EVENT_MASK(EV_WDT) | EVENT_MASK(EV_UART)) & EVENT_MASK(EV_WDT)));
+    clock_claim();
 }
 
 static void sys_init()
 {
     cli();
+    power_init();
     set_sleep_mode(SLEEP_MODE_IDLE);
     sleep_enable();
     gpio_enable_reset_pullup();
-    uart_init();
+    uart_init(1);
+    DDRB = 0b000001; //PB0 - Si4432 SDN
     spi_init();
+    twi_init();
+    clock_claim();
+    clock_init();
     wdt_reset();
     wdt_set_2s();
     sei();
-    fprintf(&uart_str, "main\r\n");
+    p_line_P(PSTR("main"));
 }
 
 static void adc_set_src_1_1v__ref_avcc_with_cap_at_aref_pin()   { ADMUX = 0b01001110; }
@@ -149,41 +122,53 @@ static uint16_t adc_read_result_16()                            { return ADC; }
 static void adc_src_gnd__ref_off()                              { ADMUX = 0b00001111; }
 static void adc_disable__div_128()                              { ADCSRA = 0b00000111; }
 
+//every measurement claims the ADC, adc_release() gates it again
+static void adc_claim()
+{
+    power_claim(POWER_ADC);
+}
+
 static void adc_release()
 {
     adc_src_gnd__ref_off();
     adc_disable__div_128();
+    power_release(POWER_ADC);
 }
 
-static void f0_vcc_read(const char* descr)
+static void f0_vcc_read(PGM_P descr)
 {
+    adc_claim();
     adc_set_src_1_1v__ref_avcc_with_cap_at_aref_pin();
     adc_enable_start_conversion__div_2();
     adc_wait_convertion();
-    float vcc = adc_read_result_16();
+    //Q16.16 running average of the 1.1 V reading
+    int32_t vcc = (int32_t)adc_read_result_16() << 16;
     uint8_t cnt = 0xFF;
     while(cnt --) {
         adc_enable_start_conversion__div_2();
         adc_wait_convertion();
-        vcc += adc_read_result_16();
-        vcc /= 2.0;
+        vcc += (int32_t)adc_read_result_16() << 16;
+        vcc >>= 1;
     }
     adc_release();
-    fprintf(&uart_str, "%s: %u mV\r\n", descr, (uint16_t)(1100.0 * 1023.0 / vcc));
+    p_str_P(descr);
+    p_str_P(PSTR(": "));
+    p_u16(q16_int(q16_mul(Q16_16(1100), q16_div(Q16_16(1023), vcc))));
+    p_line_P(PSTR(" mV"));
 }
 
-static void f0_gpio_set(const char* descr)
+static void f0_gpio_set(PGM_P descr)
 {
     DDRC = 0b00000001;
     PORTC = 0b00000001;
-    fprintf(&uart_str, "%s\r\n", descr);
+    p_line_P(descr);
 }
 
-static void f0_gpio_unset(const char* descr)
+static void f0_gpio_unset(PGM_P descr)
 {
     DDRC = 0b00000001;
     PORTC = 0b00000000;
-    fprintf(&uart_str, "%s\r\n", descr);
+    p_line_P(descr);
 }
 
 static uint16_t adc_warmup_wait_read()
@@ -210,24 +195,32 @@ static uint16_t adc_wait_read_128()
     return val;
 }
 
-static void f0_adc_read(const char* descr)
+static void f0_adc_read(PGM_P descr)
 {
     DDRC = 0b00000000;
+    adc_claim();
     adc_set_src_adc0__ref_vcc_with_cap_at_aref_pin();
     uint16_t val = adc_warmup_wait_read();
     adc_release();
-    fprintf(&uart_str, "%s: %u\r\n", descr, val);
+    p_str_P(descr);
+    p_str_P(PSTR(": "));
+    p_u16(val);
+    p_crlf();
 }
 
-static void f0_temp_read(const char* descr)
+static void f0_temp_read(PGM_P descr)
 {
+    adc_claim();
     adc_set_src_temp__ref_1_1v_with_cap_at_aref_pin();
     uint16_t val = adc_warmup_wait_read();
     adc_release();
-    fprintf(&uart_str, "%s: %u\r\n", descr, val);
+    p_str_P(descr);
+    p_str_P(PSTR(": "));
+    p_u16(val);
+    p_crlf();
 }
 
-static void f0_gpio_time(const char* descr)
+static void f0_gpio_time(PGM_P descr)
 {
     DDRD = 0b00010000;
     PORTD = 0b00000000;
@@ -237,7 +230,10 @@ static void f0_gpio_time(const char* descr)
     uint8_t i = 255;
     while(i-- && !(PIND & 0b00010000));
 
-    fprintf(&uart_str, "%s %d\r\n", descr, i);
+    p_str_P(descr);
+    p_char(' ');
+    p_u16(i);
+    p_crlf();
 //    fprintf(&uart_str, "%s %d%d%d%d%d%d%d%d%d%d%d%d%d%d%d%d\r\n", descr
 //            , !!(PIND & 0b00010000)
 //            , !!(PIND & 0b00010000)
@@ -257,27 +253,66 @@ static void f0_gpio_time(const char* descr)
 //            , !!(PIND & 0b00010000));
 }
 
-static void f0_cpu_clock_test(const char* descr)
+static void f0_cpu_clock_test(PGM_P descr)
+{
+    p_line_P(descr);
+    p_line_P(PSTR("CPU 31250 Hz 5s")); //3.3v0.15ma,5v9.9ma
+    clock_set(8);
+    clock_delay_ms(5000);
+    clock_set(0);
+    p_line_P(PSTR("CPU 128 KHz 5s")); //3.3v0.21ma,5v9.9ma
+    clock_set(6);
+    clock_delay_ms(5000);
+    clock_set(0);
+    p_line_P(PSTR("CPU 1 Mhz 5s")); //3.3v0.74ma,5v10.9ma
+    clock_set(3);
+    clock_delay_ms(5000);
+    clock_set(0);
+    p_line_P(PSTR("CPU 8 Mhz 5s")); //3.3v3.74ma,5v16.3ma
+    clock_delay_ms(5000);
+    p_line_P(PSTR("CPU done\r\n"));
+}
+
+static void p_sleep_mode(uint8_t mode)
+{
+    switch(mode) {
+    case SLEEP_MODE_IDLE:       p_str_P(PSTR("Idle")); break;
+    case SLEEP_MODE_ADC:        p_str_P(PSTR("ADC noise reduction")); break;
+    case SLEEP_MODE_PWR_SAVE:   p_str_P(PSTR("Power-save")); break;
+    case SLEEP_MODE_PWR_DOWN:   p_str_P(PSTR("Power-down")); break;
+    default:                    p_hex8(mode); break;
+    }
+}
+
+//two WDT periods (2..4 s) in a mode, bytes received meanwhile are lost
+static void sleep_mode_test(uint8_t mode)
+{
+    p_sleep_mode(mode);
+    p_line_P(PSTR(" 4s"));
+    uart_tx_flush();
+    set_sleep_mode(mode);
+    for(uint8_t i = 0; i < 2; i ++) {
+        event_clear(EVENT_MASK(EV_WDT));
+        cli();
+        while(!(EVENT_REG & EVENT_MASK(EV_WDT))) {
+            sei();
+            sleep_cpu();
+            cli();
+        }
+        sei();
+    }
+    set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+//sleep current per mode, read with a meter
+static void f0_sleep_modes(PGM_P descr)
 {
-    fprintf(&uart_str, "%s\r\n", descr);
-    fprintf(&uart_str, "CPU 31250 Hz 5s\r\n"); //3.3v0.15ma,5v9.9ma
-    _delay_ms(5);
-    cpu_clock_div_set(0b00001000);
-    _delay_ms(5000 / 256);
-    cpu_clock_div_set(0b00000000);
-    fprintf(&uart_str, "CPU 128 KHz 5s\r\n"); //3.3v0.21ma,5v9.9ma
-    _delay_ms(5);
-    cpu_clock_div_set(0b00000110);
-    _delay_ms(5000 / 64);
-    cpu_clock_div_set(0b00000000);
-    fprintf(&uart_str, "CPU 1 Mhz 5s\r\n"); //3.3v0.74ma,5v10.9ma
-    _delay_ms(5);
-    cpu_clock_div_set(0b00000011);
-    _delay_ms(5000 / 8);
-    cpu_clock_div_set(0b00000000);
-    fprintf(&uart_str, "CPU 8 Mhz 5s\r\n"); //3.3v3.74ma,5v16.3ma
-    _delay_ms(5000);
-    fprintf(&uart_str, "CPU done\r\n\r\n");
+    p_line_P(descr);
+    sleep_mode_test(SLEEP_MODE_IDLE);
+    sleep_mode_test(SLEEP_MODE_ADC);
+    sleep_mode_test(SLEEP_MODE_PWR_SAVE);
+    sleep_mode_test(SLEEP_MODE_PWR_DOWN);
+    p_line_P(PSTR("Sleep done\r\n"));
 }
 
 static void charge_loop()
@@ -286,18 +321,24 @@ static void charge_loop()
     while(1) {
         DDRC = 0b00000001;
         PORTC = 0b00000001;
-        sleep_cpu();
-        if(UCSR0A & (1 << RXC0)) {
+        sys_sleep();
+        if(uart_rx_available()) {
             break;
         }
         PORTC = 0b00000000;
         DDRC = 0b00000000;
         _delay_ms(100);
+        adc_claim();
         adc_set_src_adc0__ref_vcc_with_cap_at_aref_pin();
         uint16_t val = adc_wait_read_128();
         adc_release();
         if(val > 980) {
-            fprintf(&uart_str, "%s %d: %u\r\n", __func__, cnt, val);
+            p_str_P(PSTR("charge_loop"));
+            p_char(' ');
+            p_u16(cnt);
+            p_str_P(PSTR(": "));
+            p_u16(val);
+            p_crlf();
             break;
         }
         cnt ++;
@@ -310,177 +351,75 @@ static void discharge_loop()
     while(1) {
         DDRC = 0b00000001;
         PORTC = 0b00000000;
-        sleep_cpu();
-        if(UCSR0A & (1 << RXC0))
+        sys_sleep();
+        if(uart_rx_available())
             break;
         PORTC = 0b00000000;
         DDRC = 0b00000000;
         _delay_ms(100);
+        adc_claim();
         adc_set_src_adc0__ref_vcc_with_cap_at_aref_pin();
         uint16_t val = adc_wait_read_128();
         adc_release();
         if(val < 10) {
-            fprintf(&uart_str, "%s %d: %u\r\n", __func__, cnt, val);
+            p_str_P(PSTR("discharge_loop"));
+            p_char(' ');
+            p_u16(cnt);
+            p_str_P(PSTR(": "));
+            p_u16(val);
+            p_crlf();
             break;
         }
         cnt ++;
     }
 }
 
-static void f0_cap_train(const char* descr)
+static void f0_cap_train(PGM_P descr)
 {
     int cnt = 0;
-    fprintf(&uart_str, "Start %s\r\n", descr);
+    p_str_P(PSTR("Start "));
+    p_line_P(descr);
     while(1) {
         discharge_loop();
-        if(UCSR0A & (1 << RXC0))
+        if(uart_rx_available())
             break;
         charge_loop();
-        if(UCSR0A & (1 << RXC0))
+        if(uart_rx_available())
             break;
-        fprintf(&uart_str, "%s %d\r\n", descr, cnt);
+        p_str_P(descr);
+        p_char(' ');
+        p_i16(cnt);
+        p_crlf();
         cnt ++;
     }
     adc_release();
     PORTC = 0b00000000;
     DDRC = 0b00000000;
-    fprintf(&uart_str, "End %s %d\r\n", descr, cnt);
-}
-
-static void twi_init_400khz()
-{
-    TWSR = 0x00;
-    TWBR = 0x0C;
-    TWCR = (1 << TWEN);
-}
-
-static void twi_wait_complete()
-{
-    while(!(TWCR & (1 << TWINT)));
-}
-
-static void twi_send_start()
-{
-    TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
-    twi_wait_complete();
-}
-
-static void twi_send_stop()
-{
-    TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
-}
-
-static void twi_write(uint8_t data)
-{
-    TWDR = data;
-    TWCR = (1 << TWINT) | (1 << TWEN);
-    twi_wait_complete();
-}
-
-static uint8_t twi_read_ack()
-{
-    TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
-    twi_wait_complete();
-    return TWDR;
-}
-
-static uint8_t twi_read_nack()
-{
-    TWCR = (1 << TWINT) | (1 << TWEN);
-    twi_wait_complete();
-    return TWDR;
-}
-
-static uint8_t twi_get_status()
-{
-    return TWSR & 0xF8;
-}
-
-static uint8_t i2c_read_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
-{
-    uint8_t res = 1;
-    twi_send_start();
-
-    if(TW_START != twi_get_status())
-        return res;
-
-    twi_write(dev_addr);
-    if(TW_MT_SLA_ACK != twi_get_status())
-        goto stop;
-
-    twi_write(reg_addr);
-    if(TW_MT_DATA_ACK != twi_get_status())
-        goto stop;
-
-    twi_send_start();
-    if(TW_REP_START != twi_get_status())
-        goto stop;
-
-    twi_write(dev_addr | 1);
-    if(TW_MR_SLA_ACK != twi_get_status())
-        goto stop;
-
-    while(-- len) {
-        *data ++ = twi_read_ack();
-        if(TW_MR_DATA_ACK != twi_get_status()) {
-            goto stop;
-        }
-    }
-
-    *data = twi_read_nack();
-    if(TW_MR_DATA_NACK != twi_get_status())
-        goto stop;
-
-    res = 0;
-
-stop:
-    twi_send_stop();
-    return res;
-}
-
-static uint8_t i2c_write_reg(uint8_t dev_addr, uint8_t reg_addr, uint8_t* data, uint8_t len)
-{
-    uint8_t res = 1;
-    twi_send_start();
-
-    if(TW_START != twi_get_status())
-        return res;
-
-    twi_write(dev_addr);
-    if(TW_MT_SLA_ACK != twi_get_status())
-        goto stop;
-
-    twi_write(reg_addr);
-    if(TW_MT_DATA_ACK != twi_get_status())
-        goto stop;
-
-    while(len --) {
-        twi_write(*data ++);
-        if(TW_MT_DATA_ACK != twi_get_status()) {
-            goto stop;
-        }
-    }
-
-    res = 0;
-
-stop:
-    twi_send_stop();
-    return res;
+    p_str_P(PSTR("End "));
+    p_str_P(descr);
+    p_char(' ');
+    p_i16(cnt);
+    p_crlf();
 }
 
 #define LM75_ADDR       0x90
 
-static void f0_lm75_read(const char* descr)
+//both transfers queued at once, the CPU sleeps until the read is done
+static void f0_lm75_read(PGM_P descr)
 {
+    struct TWI_XFER wake, read;
     uint8_t buff[2];
     uint8_t cfg = 0b00000000; //wake up
-    if(i2c_write_reg(LM75_ADDR, 1, &cfg, sizeof(cfg))) {
-        fprintf(&uart_str, "Error wakeup\r\n");
+    i2c_write_reg_async(&wake, LM75_ADDR, 1, &cfg, sizeof(cfg), 0);
+//    _delay_ms(500);
+    i2c_read_reg_async(&read, LM75_ADDR, 0, buff, sizeof(buff), 0);
+    twi_wait(&read);
+    if(TWI_DONE != wake.status) {
+        p_line_P(PSTR("Error wakeup"));
         return;
     }
-//    _delay_ms(500);
-    if(i2c_read_reg(LM75_ADDR, 0, buff, sizeof(buff))) {
-        fprintf(&uart_str, "Error reading temperature\r\n");
+    if(TWI_DONE != read.status) {
+        p_line_P(PSTR("Error reading temperature"));
         return;
     }
 //    cfg = 0b00000001; //shut down
@@ -490,81 +429,168 @@ static void f0_lm75_read(const char* descr)
 //    }
 
     int16_t temp = buff[0] << 8 | buff[1];
-    fprintf(&uart_str, "%s: %d\r\n", descr, temp / 256);
+    p_str_P(descr);
+    p_str_P(PSTR(": "));
+    p_i16(temp / 256);
+    p_crlf();
 }
 
-static void f1_si4432_transmit(const char* descr)
+static void f1_si4432_transmit(PGM_P descr)
 {
     spi_print_reg(0x00);
     spi_print_reg(0x01);
     spi_print_reg(0x02);
 }
 
+//menu tables and their descriptions are in flash
 struct MENU_ITEM {
-    char* descr;
-    void (*proc)();
+    PGM_P descr;
+    void (*proc)(PGM_P descr);
 };
 
+//keys typed ahead wait in the RX ring and are handled in order; a key
+//arriving between the ring check and the sleep leaves EV_UART pending
 static uint8_t sys_wait_key_press()
 {
-    do {
-        sleep_cpu();
-    }while(!(UCSR0A & (1 << RXC0)));
-    return UDR0;
+    uint8_t ch;
+    clock_release();
+    while(!uart_rx_read(&ch))
+        event_wait(EVENT_MASK(EV_UART));
+    clock_claim();
+    return ch;
 }
 
-static void menu(const char* title, struct MENU_ITEM item_arr[], uint8_t count)
+static void menu(PGM_P title, const struct MENU_ITEM item_arr[], uint8_t count)
 {
-    fprintf(&uart_str, "\r\n%s.\r\n", title);
+    struct MENU_ITEM item;
+    p_crlf();
+    p_str_P(title);
+    p_line_P(PSTR("."));
     while(1) {
         uint8_t ch = sys_wait_key_press();
         if('q' == ch)
             break;
 
         if(ch < 'a' || ch >= 'a' + count) {
-            fprintf(&uart_str, "\r\n%s:\r\n", title);
-            fprintf(&uart_str, "q: leave %s\r\n", title);
+            p_crlf();
+            p_str_P(title);
+            p_line_P(PSTR(":"));
+            p_str_P(PSTR("q: leave "));
+            p_line_P(title);
 
             for(uint8_t i = 0; i < count; i ++) {
-                fprintf(&uart_str, "%c: %s\r\n", 'a' + i, item_arr[i].descr);
+                memcpy_P(&item, &item_arr[i], sizeof(item));
+                p_char('a' + i);
+                p_str_P(PSTR(": "));
+                p_line_P(item.descr);
             }
-            fprintf(&uart_str, "\r\n");
+            p_crlf();
             continue;
         }
 
-        ch -= 'a';
-        item_arr[ch].proc(item_arr[ch].descr);
+        memcpy_P(&item, &item_arr[ch - 'a'], sizeof(item));
+        item.proc(item.descr);
     }
-    fprintf(&uart_str, "\r\nLeft %s.\r\n", title);
+    p_str_P(PSTR("\r\nLeft "));
+    p_str_P(title);
+    p_line_P(PSTR("."));
 }
 
-static void f0_level_1(const char* descr)
+#ifdef FIXED_BENCH
+/*
+lib/fixed.h against float, CPU cycles per operation (Timer1 at F_CPU / 1,
+the empty measurement subtracted). Build with -DFIXED_BENCH.
+*/
+#include <math.h>
+
+static volatile int32_t g_bench_q[2] = {Q16_16(3.3), Q16_16(-1.7)};
+static volatile int16_t g_bench_q8[2] = {Q8_8(3.3), Q8_8(-1.7)};
+static volatile float g_bench_f[2] = {3.3, -1.7};
+
+#define FIXED_BENCH_RUN(name, expr) do { \
+    cli(); \
+    TCNT1 = 0; \
+    expr; \
+    uint16_t t = TCNT1; \
+    sei(); \
+    p_str_P(PSTR(name)); \
+    p_u16(t - base); \
+    p_crlf(); \
+} while(0)
+
+static void f0_fixed_bench(PGM_P descr)
+{
+    uint16_t base;
+    p_line_P(descr);
+    power_claim(POWER_TIMER1);
+    TCCR1A = 0;
+    TCCR1B = 1 << CS10;
+    cli();
+    TCNT1 = 0;
+    base = TCNT1;
+    sei();
+    FIXED_BENCH_RUN("q8_mul    ", g_bench_q8[0] = q8_mul(g_bench_q8[0], g_bench_q8[1]));
+    FIXED_BENCH_RUN("q8_div    ", g_bench_q8[0] = q8_div(g_bench_q8[0], g_bench_q8[1]));
+    FIXED_BENCH_RUN("q16_mul   ", g_bench_q[0] = q16_mul(g_bench_q[0], g_bench_q[1]));
+    FIXED_BENCH_RUN("q16_div   ", g_bench_q[0] = q16_div(g_bench_q[0], g_bench_q[1]));
+    FIXED_BENCH_RUN("q16_sin   ", g_bench_q[0] = q16_sin(g_bench_q[1]));
+    FIXED_BENCH_RUN("float mul ", g_bench_f[0] = g_bench_f[0] * g_bench_f[1]);
+    FIXED_BENCH_RUN("float div ", g_bench_f[0] = g_bench_f[0] / g_bench_f[1]);
+    FIXED_BENCH_RUN("sin       ", g_bench_f[0] = sin(g_bench_f[1]));
+    TCCR1B = 0;
+    power_release(POWER_TIMER1);
+}
+#endif
+
+static const char s_f1_si4432_transmit[] PROGMEM = "Si4432 transmit";
+
+static const struct MENU_ITEM f1_menu[] PROGMEM = {
+    {s_f1_si4432_transmit,  f1_si4432_transmit},
+};
+
+static void f0_level_1(PGM_P descr)
 {
-    struct MENU_ITEM f1_menu[] = {
-        {"Si4432 transmit", f1_si4432_transmit},
-    };
     menu(descr, f1_menu, sizeof(f1_menu) / sizeof(f1_menu[0]));
 }
 
+static const char s_f0_vcc_read[] PROGMEM       = "VCC read";
+static const char s_f0_gpio_set[] PROGMEM       = "GPIO set";
+static const char s_f0_gpio_unset[] PROGMEM     = "GPIO unset";
+static const char s_f0_adc_read[] PROGMEM       = "ADC read";
+static const char s_f0_temp_read[] PROGMEM      = "Temp. read";
+static const char s_f0_gpio_time[] PROGMEM      = "GPIO dU/dT";
+static const char s_f0_cpu_clock_test[] PROGMEM = "Clock test";
+static const char s_f0_sleep_modes[] PROGMEM    = "Sleep modes";
+static const char s_f0_cap_train[] PROGMEM      = "Cap train";
+static const char s_f0_lm75_read[] PROGMEM      = "LM75 read";
+static const char s_f0_level_1[] PROGMEM        = "Level 1";
+#ifdef FIXED_BENCH
+static const char s_f0_fixed_bench[] PROGMEM    = "Fixed bench";
+#endif
+
+static const struct MENU_ITEM f0_menu[] PROGMEM = {
+    {s_f0_vcc_read,         f0_vcc_read},
+    {s_f0_gpio_set,         f0_gpio_set},
+    {s_f0_gpio_unset,       f0_gpio_unset},
+    {s_f0_adc_read,         f0_adc_read},
+    {s_f0_temp_read,        f0_temp_read},
+    {s_f0_gpio_time,        f0_gpio_time},
+    {s_f0_cpu_clock_test,   f0_cpu_clock_test},
+    {s_f0_sleep_modes,      f0_sleep_modes},
+    {s_f0_cap_train,        f0_cap_train},
+    {s_f0_lm75_read,        f0_lm75_read},
+    {s_f0_level_1,          f0_level_1},
+#ifdef FIXED_BENCH
+    {s_f0_fixed_bench,      f0_fixed_bench},
+#endif
+};
+
 int main(void)
 {
-    struct MENU_ITEM f0_menu[] = {
-        {"VCC read",    f0_vcc_read},
-        {"GPIO set",    f0_gpio_set},
-        {"GPIO unset",  f0_gpio_unset},
-        {"ADC read",    f0_adc_read},
-        {"Temp. read",  f0_temp_read},
-        {"GPIO dU/dT",  f0_gpio_time},
-        {"Clock test",  f0_cpu_clock_test},
-        {"Cap train",   f0_cap_train},
-        {"LM75 read",   f0_lm75_read},
-        {"Level 1",     f0_level_1},
-    };
-
     sys_init();
 
     while(1)
-        menu("Level 0", f0_menu, sizeof(f0_menu) / sizeof(f0_menu[0]));
+        menu(PSTR("Level 0"), f0_menu, sizeof(f0_menu) / sizeof(f0_menu[0]));
 
     return 0;
 }
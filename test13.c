@@ -7,27 +7,24 @@
 #include <avr/interrupt.h>
 #include <avr/sleep.h>
 #include <util/twi.h>
-#include <stdio.h>
 
 #define F_CPU 1000000UL
 #include <util/delay.h>
 
-#define USART_BAUD 38400UL
-#define USART_UBBR_VALUE ((F_CPU / (USART_BAUD << 4)) - 1)
+#define UART_BAUD 9600UL
+#include "lib/power.h"
+#include "lib/uart.h"
+#include "lib/print.h"
+#include "lib/spi.h"
+#include "lib/soft_timer.h"
 
-
-static int uart_print_char(char ch, FILE* pf)
+//power-down between the WDT ticks, the UART output finished first
+static void sys_sleep(uint16_t ticks)
 {
-    while (!(UCSR0A & (1 << UDRE0)));
-    UDR0 = ch;
-    return 0;
+    uart_tx_flush();
+    timer_sleep(ticks);
 }
 
-static FILE uart_str = {
-    .put = uart_print_char,
-    .flags = _FDEV_SETUP_WRITE
-};
-
 static void led_flash_1()
 {
     PORTD |= 0b10000000;
@@ -42,31 +39,14 @@ static void led_flash_2()
     led_flash_1();
 }
 
-static uint8_t spi_read_reg(uint8_t reg)
-{
-    PORTB &= ~0b00000100;
-    SPDR = reg;
-    while(!(SPSR & (1 << SPIF)));
-    SPDR = 0;
-    while(!(SPSR & (1 << SPIF)));
-    PORTB |= 0b00000100;
-    return SPDR;
-}
-
-static void spi_write_reg(uint8_t reg, uint8_t val)
-{
-    PORTB &= ~0b00000100;
-    SPDR = reg | 0x80;
-    while(!(SPSR & (1 << SPIF)));
-    SPDR = val;
-    while(!(SPSR & (1 << SPIF)));
-    PORTB |= 0b00000100;
-}
-
 static void spi_print_reg(uint8_t reg)
 {
     uint8_t val = spi_read_reg(reg);
-    fprintf(&uart_str, "REG %02X=%02X\r\n", reg, val);
+    p_str("REG ");
+    p_hex8(reg);
+    p_char('=');
+    p_hex8(val);
+    p_str("\r\n");
 }
 
 static void si4432_cleanup_interrupt_status_regs()
@@ -321,7 +301,7 @@ static void si4432_tx_433_92mhz_20dbm_unmodulated_500ms()
 
     led_flash_1();
 
-    _delay_ms(500);
+    sys_sleep(TIMER_MS(500));
 
     //shutdown si4431
     PORTB |= 0b00000001;
@@ -422,7 +402,7 @@ static void si4432_tx_433_92mhz_gfsk_25khz_1_24kbs_20dbm()
     si4432_cleanup_interrupt_status_regs();
 
     while(1) {
-        _delay_ms(2000);
+        sys_sleep(TIMER_MS(2000));
         si4432_fill_fifo(data, sizeof(data));
         led_flash_1();
         si4432_tx_enable();
@@ -521,7 +501,7 @@ static void si4432_tx_915mhz_gfsk_45khz_9_6kbs()
     si4432_set_tx_power_20dbm();
 
     while(1) {
-        _delay_ms(2000);
+        sys_sleep(TIMER_MS(2000));
         led_flash_1();
 
         spi_write_reg(0x3E, 0x08);
@@ -598,18 +578,18 @@ int main()
     CLKPR = 0x80;
     CLKPR = 0x03;
 
-    UBRR0 = USART_UBBR_VALUE;
-    UCSR0A = 0;
-    UCSR0B = (1 << TXEN0);
-    //8 data bits, 1 stop bit
-    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+    power_init();
+    uart_init(0);
 
-    DDRB = 0b101101;
+    DDRB = 0b000001;
     PORTB |= 0b00000001; //shutdown si4432
     DDRD |= 0b10000000;
 
-    SPSR = SPI2X; //clk / 2
-    SPCR = (1 << SPE) | (1 << MSTR);
+    spi_init();
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    timer_init();
 
     sei();
 